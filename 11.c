@@ -10,39 +10,96 @@ Here’s a C program implementing the LRU page replacement algorithm with a mini
 
 #define MAX_FRAMES 3
 #define MAX_PAGES 20
+#define HASH_SIZE 8 // Power of two, at least twice MAX_FRAMES
+#define NONE -1
+
+// A frame is also a node of the recency list, which runs from most to least recently used
+struct Frame {
+    int page;
+    int prev; // Frame used more recently, or NONE
+    int next; // Frame used less recently, or NONE
+};
 
 int pages[MAX_PAGES]; // Array to hold the pages
-int frames[MAX_FRAMES]; // Array to hold the frames
+struct Frame frames[MAX_FRAMES]; // Array to hold the frames
+int table[HASH_SIZE]; // Hash table from page to frame, NONE in an empty slot
+int head = NONE; // Most recently used frame
+int tail = NONE; // Least recently used frame
 int pageFaults = 0; // Counter for page faults
 int pageIndex = 0; // To keep track of the index of the frames
 
-// Function to check if a page is in frames
-bool isPageInFrames(int page) {
-    for (int i = 0; i < MAX_FRAMES; i++) {
-        if (frames[i] == page) {
-            return true; // Page is found in frames
+// Function to find the first hash table slot of a page
+int hashSlot(int page) {
+    return (unsigned)page * 2654435761u % HASH_SIZE;
+}
+
+// Function to find the frame holding a page, or NONE if it is not in frames
+int findFrame(int page) {
+    for (int i = hashSlot(page); table[i] != NONE; i = (i + 1) % HASH_SIZE) {
+        if (frames[table[i]].page == page) {
+            return table[i]; // Page is found in frames
         }
     }
-    return false; // Page not found in frames
+    return NONE; // Page not found in frames
 }
 
-// Function to get the index of the least recently used page
-int getLRUPage() {
-    int lruIndex = 0;
-    for (int i = 1; i < MAX_FRAMES; i++) {
-        if (frames[i] < frames[lruIndex]) {
-            lruIndex = i; // Update LRU index
+// Function to record that a frame now holds a page
+void insertPage(int frame) {
+    int i = hashSlot(frames[frame].page);
+    while (table[i] != NONE) {
+        i = (i + 1) % HASH_SIZE;
+    }
+    table[i] = frame;
+}
+
+// Function to forget the page of a frame, moving back entries that were placed after it
+void removePage(int frame) {
+    int i = hashSlot(frames[frame].page);
+    while (table[i] != frame) {
+        i = (i + 1) % HASH_SIZE;
+    }
+    for (int j = (i + 1) % HASH_SIZE; table[j] != NONE; j = (j + 1) % HASH_SIZE) {
+        int home = hashSlot(frames[table[j]].page);
+        if ((j - home + HASH_SIZE) % HASH_SIZE >= (j - i + HASH_SIZE) % HASH_SIZE) {
+            table[i] = table[j];
+            i = j;
         }
     }
-    return lruIndex;
+    table[i] = NONE;
+}
+
+// Function to take a frame out of the recency list
+void unlinkFrame(int frame) {
+    if (frames[frame].prev != NONE) {
+        frames[frames[frame].prev].next = frames[frame].next;
+    } else {
+        head = frames[frame].next;
+    }
+    if (frames[frame].next != NONE) {
+        frames[frames[frame].next].prev = frames[frame].prev;
+    } else {
+        tail = frames[frame].prev;
+    }
+}
+
+// Function to make a frame the most recently used
+void pushFront(int frame) {
+    frames[frame].prev = NONE;
+    frames[frame].next = head;
+    if (head != NONE) {
+        frames[head].prev = frame;
+    } else {
+        tail = frame;
+    }
+    head = frame;
 }
 
 // Function to display the frames
 void displayFrames() {
     printf("Current frames: ");
     for (int i = 0; i < MAX_FRAMES; i++) {
-        if (frames[i] != -1) {
-            printf("%d ", frames[i]);
+        if (i < pageIndex) {
+            printf("%d ", frames[i].page);
         } else {
             printf(" - ");
         }
@@ -52,31 +109,38 @@ void displayFrames() {
 
 // Function to implement LRU Page Replacement
 void lruPageReplacement(int pages[], int n) {
-    // Initialize frames
-    for (int i = 0; i < MAX_FRAMES; i++) {
-        frames[i] = -1; // Set frames to empty
+    // Initialize the hash table
+    for (int i = 0; i < HASH_SIZE; i++) {
+        table[i] = NONE; // Set slots to empty
     }
 
     for (int i = 0; i < n; i++) {
         printf("Processing page: %d\n", pages[i]);
 
-        // If page is not in frames, we have a page fault
-        if (!isPageInFrames(pages[i])) {
-            pageFaults++;
-            
+        int frame = findFrame(pages[i]);
+        if (frame != NONE) {
+            // A hit makes the page the most recently used
+            unlinkFrame(frame);
+            pushFront(frame);
+            printf("Page %d already in frames, no page fault.\n", pages[i]);
+            continue;
+        }
+
+        // Page is not in frames, we have a page fault
+        pageFaults++;
+        if (pageIndex < MAX_FRAMES) {
             // If there's an empty frame, use it
-            if (pageIndex < MAX_FRAMES) {
-                frames[pageIndex] = pages[i];
-                pageIndex++;
-            } else {
-                // Replace the least recently used page
-                int lruIndex = getLRUPage();
-                frames[lruIndex] = pages[i];
-            }
-            displayFrames(); // Show current frames after page replacement
+            frame = pageIndex++;
         } else {
-            printf("Page %d already in frames, no page fault.\n", pages[i]);
+            // Replace the least recently used page
+            frame = tail;
+            unlinkFrame(frame);
+            removePage(frame);
         }
+        frames[frame].page = pages[i];
+        insertPage(frame);
+        pushFront(frame);
+        displayFrames(); // Show current frames after page replacement
     }
 }
 
@@ -107,17 +171,20 @@ int main() {
 
 1. **Data Structures**:
    - `pages[]`: Holds the page numbers that need to be loaded.
-   - `frames[]`: Holds the pages currently in frames (physical memory).
+   - `frames[]`: Holds the pages currently in frames (physical memory). Each frame is also a node of a doubly linked recency list, from `head` (most recently used) to `tail` (least recently used).
+   - `table[]`: A hash table from page number to the frame holding it, so finding a page does not scan every frame.
    - `pageFaults`: Counts the total number of page faults.
    - `pageIndex`: Keeps track of the next available index in the frames.
 
 2. **Functions**:
-   - **`isPageInFrames(int page)`**: Checks if a page is currently loaded in frames.
-   - **`getLRUPage()`**: Determines which page in frames is the least recently used.
+   - **`findFrame(int page)`**: Looks a page up in the hash table and returns its frame, or `NONE` if it is not loaded.
+   - **`insertPage(int frame)`** and **`removePage(int frame)`**: Add and remove the page of a frame in the hash table.
+   - **`unlinkFrame(int frame)`** and **`pushFront(int frame)`**: Take a frame out of the recency list and put it back at the most recently used end.
    - **`displayFrames()`**: Displays the current contents of the frames.
    - **`lruPageReplacement(int pages[], int n)`**: Implements the LRU page replacement algorithm:
-     - For each page, it checks if it’s already in frames.
-     - If not, it incurs a page fault and either loads it into an empty frame or replaces the least recently used page if all frames are full.
+     - For each page, it looks the page up in the hash table. A hit moves its frame to the front of the recency list.
+     - A miss incurs a page fault and either loads the page into an empty frame or replaces the page at the tail of the list, which is the least recently used one.
+     - Every step takes the same time however many frames there are, so `MAX_FRAMES` can be raised to millions (with `HASH_SIZE` kept a power of two at least twice as large).
 
 ### Steps to Compile and Run the Code:
 
@@ -144,24 +211,26 @@ Enter the page numbers:
 **Output**:
 ```
 Processing page: 7
-Current frames: 7 - - 
+Current frames: 7  -  - 
 Processing page: 0
-Current frames: 7 0 - 
+Current frames: 7 0  - 
 Processing page: 1
 Current frames: 7 0 1 
 Processing page: 2
 Current frames: 2 0 1 
-Processing page: 0 already in frames, no page fault.
+Processing page: 0
+Page 0 already in frames, no page fault.
 Processing page: 3
-Current frames: 2 3 1 
+Current frames: 2 0 3 
 Processing page: 0
-Current frames: 0 3 1 
+Page 0 already in frames, no page fault.
 Processing page: 4
-Current frames: 0 3 4 
+Current frames: 4 0 3 
 Processing page: 2
-Current frames: 2 3 4 
-Processing page: 3 already in frames, no page fault.
-Total number of page faults: 7
+Current frames: 4 0 2 
+Processing page: 3
+Current frames: 4 3 2 
+Total number of page faults: 8
 ```
 
 ### Explanation of Output:
@@ -6,55 +6,92 @@ Here’s a C program implementing the Optimal page replacement algorithm with a
 
 ```c
 #include <stdio.h>
-#include <limits.h>
+#include <stdbool.h>
 
 #define MAX_FRAMES 3
 #define MAX_PAGES 20
+#define HASH_SIZE 64 // Power of two, at least twice MAX_PAGES
+#define NONE -1
 
 int pages[MAX_PAGES]; // Array to hold the pages
+int nextUse[MAX_PAGES]; // Index of the next reference to the same page, or n if there is none
+int frameFor[MAX_PAGES]; // Frame that will still hold the page of this reference, or NONE
 int frames[MAX_FRAMES]; // Array to hold the frames
+int frameNext[MAX_FRAMES]; // Next use of the page in each frame
+int heap[MAX_FRAMES]; // Max-heap of frames by the next use of their page
+int heapPos[MAX_FRAMES]; // Where each frame is in the heap
+int heapSize = 0; // Frames in use
+int slotPage[HASH_SIZE]; // Hash table from page to the earliest reference seen so far
+int slotIndex[HASH_SIZE]; // (NONE in an empty slot)
 int pageFaults = 0; // Counter for page faults
 
-// Function to check if a page is in frames
-int isPageInFrames(int page) {
-    for (int i = 0; i < MAX_FRAMES; i++) {
-        if (frames[i] == page) {
-            return 1; // Page is found in frames
-        }
+// Function to find the hash table slot holding a page, or the empty slot where it goes
+int hashSlot(int page) {
+    int i = (unsigned)page * 2654435761u % HASH_SIZE;
+    while (slotIndex[i] != NONE && slotPage[i] != page) {
+        i = (i + 1) % HASH_SIZE;
     }
-    return 0; // Page not found in frames
+    return i;
 }
 
-// Function to find the optimal page to replace
-int findOptimalPage(int pages[], int n, int currentIndex) {
-    int farthest = -1; // Index of the farthest page
-    int pageIndex = -1; // Page index to be replaced
+// Function to fill nextUse[] in one backward pass over the pages
+void computeNextUse(int pages[], int n) {
+    for (int i = 0; i < HASH_SIZE; i++) {
+        slotIndex[i] = NONE;
+    }
+    for (int i = n - 1; i >= 0; i--) {
+        int slot = hashSlot(pages[i]);
+        nextUse[i] = slotIndex[slot] != NONE ? slotIndex[slot] : n; // n: never used again
+        slotPage[slot] = pages[i];
+        slotIndex[slot] = i;
+    }
+}
 
-    for (int i = 0; i < MAX_FRAMES; i++) {
-        int j;
-        for (j = currentIndex; j < n; j++) {
-            if (frames[i] == pages[j]) {
-                // If the page is found in the future
-                if (j > farthest) {
-                    farthest = j; // Update the farthest reference
-                    pageIndex = i; // Update the page index to replace
-                }
-                break;
+// Function to check whether frame a should be replaced before frame b: its page is used later,
+// or neither is used again and a comes first
+bool replaceBefore(int a, int b) {
+    return frameNext[a] > frameNext[b] || (frameNext[a] == frameNext[b] && a < b);
+}
+
+// Function to swap two heap entries
+void heapSwap(int i, int j) {
+    int t = heap[i];
+    heap[i] = heap[j];
+    heap[j] = t;
+    heapPos[heap[i]] = i;
+    heapPos[heap[j]] = j;
+}
+
+// Function to move a heap entry up after its frame's next use moved later
+void siftUp(int i) {
+    while (i > 0 && replaceBefore(heap[i], heap[(i - 1) / 2])) {
+        heapSwap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+// Function to move a heap entry down after its frame's next use moved earlier
+void siftDown(int i) {
+    for (;;) {
+        int first = i;
+        for (int child = 2 * i + 1; child <= 2 * i + 2 && child < heapSize; child++) {
+            if (replaceBefore(heap[child], heap[first])) {
+                first = child;
             }
         }
-        // If the page is not found in the future
-        if (j == n) {
-            return i; // Replace this page
+        if (first == i) {
+            return;
         }
+        heapSwap(i, first);
+        i = first;
     }
-    return pageIndex; // Return the page index to be replaced
 }
 
 // Function to display the frames
 void displayFrames() {
     printf("Current frames: ");
     for (int i = 0; i < MAX_FRAMES; i++) {
-        if (frames[i] != -1) {
+        if (i < heapSize) {
             printf("%d ", frames[i]);
         } else {
             printf(" - ");
@@ -65,39 +102,50 @@ void displayFrames() {
 
 // Function to implement Optimal Page Replacement
 void optimalPageReplacement(int pages[], int n) {
-    // Initialize frames
-    for (int i = 0; i < MAX_FRAMES; i++) {
-        frames[i] = -1; // Set frames to empty
+    computeNextUse(pages, n);
+    for (int i = 0; i < n; i++) {
+        frameFor[i] = NONE;
     }
 
     for (int i = 0; i < n; i++) {
         printf("Processing page: %d\n", pages[i]);
 
-        // If page is not in frames, we have a page fault
-        if (!isPageInFrames(pages[i])) {
-            pageFaults++;
-
-            // If there's an empty frame, use it
-            int emptyFrameIndex = -1;
-            for (int j = 0; j < MAX_FRAMES; j++) {
-                if (frames[j] == -1) {
-                    emptyFrameIndex = j;
-                    break;
-                }
+        // The page is in frames exactly when the frame that held its last reference still does
+        int frame = frameFor[i];
+        if (frame != NONE) {
+            frameNext[frame] = nextUse[i];
+            siftUp(heapPos[frame]);
+            if (nextUse[i] < n) {
+                frameFor[nextUse[i]] = frame;
             }
+            printf("Page %d already in frames, no page fault.\n", pages[i]);
+            continue;
+        }
 
-            // If there is an empty frame, use it
-            if (emptyFrameIndex != -1) {
-                frames[emptyFrameIndex] = pages[i];
-            } else {
-                // Replace the optimal page
-                int optimalIndex = findOptimalPage(pages, n, i + 1);
-                frames[optimalIndex] = pages[i];
-            }
-            displayFrames(); // Show current frames after page replacement
+        // Page is not in frames, we have a page fault
+        pageFaults++;
+        if (heapSize < MAX_FRAMES) {
+            // If there's an empty frame, use it
+            frame = heapSize;
+            heap[heapSize] = frame;
+            heapPos[frame] = heapSize++;
+            frames[frame] = pages[i];
+            frameNext[frame] = nextUse[i];
+            siftUp(heapPos[frame]);
         } else {
-            printf("Page %d already in frames, no page fault.\n", pages[i]);
+            // Replace the page used again furthest in the future, at the top of the heap
+            frame = heap[0];
+            if (frameNext[frame] < n) {
+                frameFor[frameNext[frame]] = NONE;
+            }
+            frames[frame] = pages[i];
+            frameNext[frame] = nextUse[i];
+            siftDown(0);
         }
+        if (nextUse[i] < n) {
+            frameFor[nextUse[i]] = frame;
+        }
+        displayFrames(); // Show current frames after page replacement
     }
 }
 
@@ -128,16 +176,20 @@ int main() {
 
 1. **Data Structures**:
    - `pages[]`: Holds the page numbers that need to be loaded.
-   - `frames[]`: Holds the pages currently in frames (physical memory).
+   - `nextUse[]`: For every reference, the index of the next reference to the same page (`n` if the page is never used again).
+   - `frames[]`: Holds the pages currently in frames (physical memory), and `frameNext[]` the next use of each of them.
+   - `heap[]`: A max-heap of the frames ordered by the next use of their page, so the page to replace is always at the top; `heapPos[]` says where each frame is in it.
+   - `frameFor[]`: For a future reference, the frame whose page it is, as long as that page stays loaded until then.
    - `pageFaults`: Counts the total number of page faults.
 
 2. **Functions**:
-   - **`isPageInFrames(int page)`**: Checks if a page is currently loaded in frames.
-   - **`findOptimalPage(int pages[], int n, int currentIndex)`**: Determines which page in frames should be replaced based on future references.
+   - **`computeNextUse(int pages[], int n)`**: Fills `nextUse[]` in one pass from the last page to the first, remembering in a small hash table where each page was seen last.
+   - **`replaceBefore(int a, int b)`**, **`siftUp(int i)`** and **`siftDown(int i)`**: Keep the heap in order when a frame's next use changes.
    - **`displayFrames()`**: Displays the current contents of the frames.
    - **`optimalPageReplacement(int pages[], int n)`**: Implements the Optimal page replacement algorithm:
-     - For each page, it checks if it’s already in frames.
-     - If not, it incurs a page fault and either loads it into an empty frame or replaces the optimal page if all frames are full.
+     - A page is in frames exactly when `frameFor[]` names a frame for the current reference. A hit moves that frame's next use to the page's following reference.
+     - A miss incurs a page fault and either loads the page into an empty frame or replaces the page at the top of the heap. That page is used again furthest in the future, or never; among pages never used again the first frame is replaced.
+     - Instead of scanning the rest of the pages for every frame on every fault, each reference costs O(log frames), so the whole string takes O(n log frames).
 
 ### Steps to Compile and Run the Code:
 
@@ -164,21 +216,25 @@ Enter the page numbers:
 **Output**:
 ```
 Processing page: 7
-Current frames: 7 - - 
+Current frames: 7  -  - 
 Processing page: 0
-Current frames: 7 0 - 
+Current frames: 7 0  - 
 Processing page: 1
 Current frames: 7 0 1 
 Processing page: 2
 Current frames: 2 0 1 
-Processing page: 0 already in frames, no page fault.
+Processing page: 0
+Page 0 already in frames, no page fault.
 Processing page: 3
 Current frames: 2 0 3 
-Processing page: 0 already in frames, no page fault.
+Processing page: 0
+Page 0 already in frames, no page fault.
 Processing page: 4
 Current frames: 2 4 3 
-Processing page: 2 already in frames, no page fault.
-Processing page: 3 already in frames, no page fault.
+Processing page: 2
+Page 2 already in frames, no page fault.
+Processing page: 3
+Page 3 already in frames, no page fault.
 Total number of page faults: 6
 ```
 
@@ -0,0 +1,1216 @@
+// Implement a CPU scheduling simulator that runs Shortest Remaining Time First, Round Robin and a
+// Completely Fair Scheduler (CFS) style policy and a Multi-Level Feedback Queue (MLFQ) with
+// different arrival times and nice values.
+//
+// Compile: gcc -O2 18.c -o sched_sim -lm
+// Usage:   ./sched_sim [-p srtf|rr|cfs|mlfq] [-q quantum] [-L q0,q1,...] [-s period] [-b processes] [-B]
+//                     [-t timeline.bin]
+//          ./sched_sim -j timeline.bin > trace.json
+//            -p  scheduling policy (default srtf)
+//            -q  time quantum for Round Robin (prompted for when omitted), MLFQ level 0 quantum
+//            -L  MLFQ quantum of every level, highest priority first (default q, 2q, 4q)
+//            -s  MLFQ priority boost period (default 100)
+//            -b  benchmark the policy on a random workload of the given size
+//            -B  run the scaling benchmark for every policy up to 10^6 processes, and for MLFQ
+//                once more without priority boosts (mlfq-s0)
+//            -t  record which process ran when into a compact binary timeline
+//            -j  convert a recorded timeline to Chrome trace-event JSON (chrome://tracing, Perfetto)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RB_RED 0
+#define RB_BLACK 1
+
+#define NICE_0_LOAD 1024
+#define VRUNTIME_SCALE 1024 // Extra fixed-point bits so heavy weights still advance vruntime
+#define SCHED_LATENCY 24    // Period in which every runnable process should run once
+#define MIN_GRANULARITY 3   // Smallest slice handed out when many processes are runnable
+
+#define MLFQ_MAX_LEVELS 64  // One bit per level in the runqueue bitmap
+
+#define SKETCH_SUB_BITS 5                      // 32 sub-buckets per power of two, about 3% error
+#define SKETCH_SUB_BUCKETS (1 << SKETCH_SUB_BITS)
+#define SKETCH_BUCKETS (60 * SKETCH_SUB_BUCKETS) // Enough for any non-negative long long
+
+#define TIMELINE_MAGIC "SCHEDTL1"
+#define TIMELINE_FLUSH (1 << 20) // Write the segment buffer out once it holds this many bytes
+
+struct Process {
+    int pid;        // Process ID
+    int arrival;    // Arrival time
+    int burst;      // Burst time
+    int remaining;  // Remaining burst time
+    int finished;   // Is process finished
+    int nice;       // Priority, -20 (highest) to 19 (lowest)
+    int weight;     // Load weight derived from nice
+    long long vruntime; // Virtual runtime, the CFS runqueue key
+
+    // Red-black tree links for the CFS runqueue
+    struct Process *parent;
+    struct Process *left;
+    struct Process *right;
+    int color;
+
+    // MLFQ level queue links
+    struct Process *next;
+    int level;        // Level the process was last queued at
+    int used;         // Time already used from the current level's quantum
+    int boostEpoch;   // Boost period in which level and used were last valid
+};
+
+// CFS runqueue: runnable processes in a red-black tree ordered by vruntime
+struct RunQueue {
+    struct Process nil;       // Sentinel leaf
+    struct Process *root;
+    struct Process *leftmost; // Cached process with the smallest vruntime
+    long long minVruntime;    // Monotonic floor for newly arriving processes
+    long long totalWeight;    // Sum of the weights of all runnable processes
+    int count;
+};
+
+// Load weight for nice -20..19, each step is roughly 10% CPU time (same table as Linux)
+static const int niceToWeight[40] = {
+    88761, 71755, 56483, 46273, 36291,
+    29154, 23254, 18705, 14949, 11916,
+    9548,  7620,  6100,  4904,  3906,
+    3121,  2501,  1991,  1586,  1277,
+    1024,  820,   655,   526,   423,
+    335,   272,   215,   172,   137,
+    110,   87,    70,    56,    45,
+    36,    29,    23,    18,    15,
+};
+
+// MLFQ runqueue: one FIFO per priority level plus a bitmap of the non-empty levels
+struct MlfqQueue {
+    struct Process *head[MLFQ_MAX_LEVELS];
+    struct Process *tail[MLFQ_MAX_LEVELS];
+    unsigned long long bitmap; // Bit i is set when level i has runnable processes
+};
+
+// Log-linear histogram of non-negative values: exact below 64, then 32 buckets per power of
+// two. It has a fixed size and two sketches merge by adding their counts.
+struct QuantileSketch {
+    long long count;
+    long long buckets[SKETCH_BUCKETS];
+};
+
+// Constant-memory online statistics: compensated mean, variance, min/max and quantiles
+struct RunningStats {
+    long long count;
+    double sum;          // Neumaier compensated sum for the mean
+    double compensation; // Low-order bits lost from sum
+    double mean;         // Welford running mean, used for the variance
+    double m2;           // Sum of squared deviations from the mean
+    long long min;
+    long long max;
+    struct QuantileSketch sketch;
+};
+
+// Run-length encoded timeline: consecutive runs of the same process on the same CPU merge into
+// one (start, end, pid, cpu) segment, stored as varints relative to the previous segment's end
+struct Timeline {
+    FILE *out;
+    unsigned char *buf;
+    size_t len;
+    long long lastEnd;   // End of the last segment written
+    long long start;     // Pending segment, extended while the same process keeps running
+    long long end;
+    int pid;
+    int cpu;
+    long long segments;
+    const char *path;
+    int failed;          // A write failed; nothing more is written and the run fails
+};
+
+long long decisions = 0; // Number of pick-next decisions made by the last run
+
+struct Timeline timeline; // Recorder, active while timeline.out is set
+
+struct RunningStats turnaroundStats; // Turnaround of every process completed by the last run
+struct RunningStats waitingStats;    // Waiting time of every process completed by the last run
+int streamResults = 0;               // Print each process's row as soon as it completes
+
+int mlfqLevels = 0;                  // Number of MLFQ levels, 0 derives three from the quantum
+int mlfqQuantum[MLFQ_MAX_LEVELS];    // Quantum of each level, level 0 is the highest priority
+int boostPeriod = 100;               // Every process returns to level 0 this often
+
+double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int sketchIndex(long long value) {
+    if (value < 2 * SKETCH_SUB_BUCKETS) {
+        return value < 0 ? 0 : (int)value;
+    }
+    int shift = 63 - __builtin_clzll(value) - SKETCH_SUB_BITS;
+    return (shift + 1) * SKETCH_SUB_BUCKETS + (int)(value >> shift) - SKETCH_SUB_BUCKETS;
+}
+
+// Midpoint of the values that fall into a bucket
+double sketchValue(int index) {
+    if (index < 2 * SKETCH_SUB_BUCKETS) {
+        return index;
+    }
+    int shift = index / SKETCH_SUB_BUCKETS - 1;
+    long long low = (long long)(index % SKETCH_SUB_BUCKETS + SKETCH_SUB_BUCKETS) << shift;
+    return low + ((1LL << shift) - 1) / 2.0;
+}
+
+// Value at quantile q (0..1), within the relative error of one bucket
+double sketchQuantile(const struct QuantileSketch *s, double q) {
+    long long rank = (long long)ceil(q * s->count);
+    long long seen = 0;
+
+    if (rank < 1) {
+        rank = 1;
+    }
+    for (int i = 0; i < SKETCH_BUCKETS; i++) {
+        seen += s->buckets[i];
+        if (seen >= rank) {
+            return sketchValue(i);
+        }
+    }
+    return 0;
+}
+
+void statsInit(struct RunningStats *st) {
+    memset(st, 0, sizeof(*st));
+    st->min = LLONG_MAX;
+    st->max = LLONG_MIN;
+}
+
+void statsAdd(struct RunningStats *st, long long value) {
+    double x = (double)value;
+    double t = st->sum + x;
+
+    // Neumaier summation keeps the bits that a plain running sum would round away
+    if (fabs(st->sum) >= fabs(x)) {
+        st->compensation += (st->sum - t) + x;
+    } else {
+        st->compensation += (x - t) + st->sum;
+    }
+    st->sum = t;
+
+    st->count++;
+    double delta = x - st->mean;
+    st->mean += delta / st->count;
+    st->m2 += delta * (x - st->mean);
+
+    if (value < st->min) st->min = value;
+    if (value > st->max) st->max = value;
+
+    st->sketch.count++;
+    st->sketch.buckets[sketchIndex(value)]++;
+}
+
+// Fold the statistics of another run (or another thread) into st
+void statsMerge(struct RunningStats *st, const struct RunningStats *other) {
+    if (other->count == 0) {
+        return;
+    }
+    long long count = st->count + other->count;
+    double delta = other->mean - st->mean;
+
+    st->m2 += other->m2 + delta * delta * st->count * other->count / count;
+    st->mean += delta * other->count / count;
+    st->count = count;
+    st->sum += other->sum;
+    st->compensation += other->compensation;
+    if (other->min < st->min) st->min = other->min;
+    if (other->max > st->max) st->max = other->max;
+
+    st->sketch.count += other->sketch.count;
+    for (int i = 0; i < SKETCH_BUCKETS; i++) {
+        st->sketch.buckets[i] += other->sketch.buckets[i];
+    }
+}
+
+double statsMean(const struct RunningStats *st) {
+    return st->count ? (st->sum + st->compensation) / st->count : 0;
+}
+
+double statsStddev(const struct RunningStats *st) {
+    return st->count > 1 ? sqrt(st->m2 / (st->count - 1)) : 0;
+}
+
+// Sketch quantile clamped to the exact extremes, so p99.9 never exceeds the true maximum
+double statsQuantile(const struct RunningStats *st, double q) {
+    double value = sketchQuantile(&st->sketch, q);
+
+    if (st->count == 0) return 0;
+    if (value < st->min) return st->min;
+    if (value > st->max) return st->max;
+    return value;
+}
+
+// Record the completion of a process at the given time and stream its results
+void finishProcess(struct Process *p, int currentTime) {
+    int turnaround = currentTime - p->arrival;
+    int waiting = turnaround - p->burst;
+
+    p->remaining = 0;
+    p->finished = 1;
+    statsAdd(&turnaroundStats, turnaround);
+    statsAdd(&waitingStats, waiting);
+
+    if (streamResults) {
+        printf("%d\t%d\t%d\t%d\t%d\t\t%d\t\t%d\n", p->pid, p->arrival, p->burst, p->nice,
+               currentTime, turnaround, waiting);
+    }
+}
+
+int timelineOpen(const char *path) {
+    memset(&timeline, 0, sizeof(timeline));
+    timeline.out = fopen(path, "wb");
+    if (!timeline.out) {
+        perror(path);
+        return 0;
+    }
+    timeline.buf = malloc(TIMELINE_FLUSH + 64);
+    if (!timeline.buf) {
+        fprintf(stderr, "Out of memory for the timeline buffer\n");
+        fclose(timeline.out);
+        timeline.out = NULL;
+        return 0;
+    }
+    timeline.pid = -1;
+    timeline.path = path;
+    if (fwrite(TIMELINE_MAGIC, 1, 8, timeline.out) != 8) {
+        perror(path);
+        fclose(timeline.out);
+        free(timeline.buf);
+        timeline.out = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+// Write the buffered segments; after the first failure the rest are dropped
+void timelineWrite() {
+    if (!timeline.failed && fwrite(timeline.buf, 1, timeline.len, timeline.out) != timeline.len) {
+        perror(timeline.path);
+        timeline.failed = 1;
+    }
+    timeline.len = 0;
+}
+
+void putVarint(unsigned long long value) {
+    while (value >= 0x80) {
+        timeline.buf[timeline.len++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    timeline.buf[timeline.len++] = (unsigned char)value;
+}
+
+// Move the pending segment into the buffer
+void timelineFlushSegment() {
+    if (timeline.pid < 0) {
+        return;
+    }
+    putVarint(timeline.start - timeline.lastEnd);
+    putVarint(timeline.end - timeline.start);
+    putVarint(timeline.pid);
+    putVarint(timeline.cpu);
+    timeline.lastEnd = timeline.end;
+    timeline.segments++;
+    timeline.pid = -1;
+
+    if (timeline.len >= TIMELINE_FLUSH) {
+        timelineWrite();
+    }
+}
+
+// Note that pid ran on the CPU during [start, end)
+void recordRun(int pid, long long start, long long end) {
+    if (!timeline.out) {
+        return;
+    }
+    if (pid == timeline.pid && start == timeline.end) {
+        timeline.end = end;
+        return;
+    }
+    timelineFlushSegment();
+    timeline.pid = pid;
+    timeline.cpu = 0; // The simulator models a single CPU
+    timeline.start = start;
+    timeline.end = end;
+}
+
+// Returns 0 if any part of the timeline could not be written, for example on a full disk
+int timelineClose() {
+    if (!timeline.out) {
+        return 1;
+    }
+    timelineFlushSegment();
+    timelineWrite();
+    if (fclose(timeline.out) != 0 && !timeline.failed) { // The last buffer may only fail here
+        perror(timeline.path);
+        timeline.failed = 1;
+    }
+    free(timeline.buf);
+    timeline.out = NULL;
+    return !timeline.failed;
+}
+
+// 1 when a value was read, 0 at the end of the file, -1 for a value longer than 64 bits
+int getVarint(FILE *in, unsigned long long *value) {
+    int c, shift = 0;
+
+    *value = 0;
+    while ((c = getc(in)) != EOF) {
+        if (shift > 63) {
+            return -1;
+        }
+        *value |= (unsigned long long)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            return 1;
+        }
+        shift += 7;
+    }
+    return 0;
+}
+
+// Write a recorded timeline as Chrome trace-event JSON, one complete ("X") event per segment
+int convertTimeline(const char *path) {
+    FILE *in = fopen(path, "rb");
+    char magic[8];
+    unsigned long long gap, duration, pid, cpu;
+    long long end = 0;
+    int first = 1;
+    int status;
+
+    if (!in) {
+        perror(path);
+        return 1;
+    }
+    if (fread(magic, 1, 8, in) != 8 || memcmp(magic, TIMELINE_MAGIC, 8) != 0) {
+        fprintf(stderr, "%s is not a scheduler timeline\n", path);
+        fclose(in);
+        return 1;
+    }
+
+    printf("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    while ((status = getVarint(in, &gap)) > 0 && (status = getVarint(in, &duration)) > 0 &&
+           (status = getVarint(in, &pid)) > 0 && (status = getVarint(in, &cpu)) > 0) {
+        long long start = end + (long long)gap;
+        end = start + (long long)duration;
+        printf("%s{\"name\": \"P%llu\", \"ph\": \"X\", \"ts\": %lld, \"dur\": %llu, \"pid\": 0, \"tid\": %llu}",
+               first ? "" : ",\n", pid, start, duration, cpu);
+        first = 0;
+    }
+    printf("\n]}\n");
+
+    fclose(in);
+    if (status < 0) {
+        fprintf(stderr, "%s is corrupt: a value is longer than 64 bits\n", path);
+        return 1;
+    }
+    return 0;
+}
+
+// Sort process indices by arrival time so arrivals can be admitted in order
+int *sortByArrival(struct Process p[], int n) {
+    int *order = malloc(n * sizeof(int));
+    int *tmp = malloc(n * sizeof(int));
+
+    for (int i = 0; i < n; i++) {
+        order[i] = i;
+    }
+
+    // Bottom-up merge sort, stable so equal arrivals keep their PID order
+    for (int width = 1; width < n; width *= 2) {
+        for (int lo = 0; lo < n; lo += 2 * width) {
+            int mid = lo + width < n ? lo + width : n;
+            int hi = lo + 2 * width < n ? lo + 2 * width : n;
+            int a = lo, b = mid, k = lo;
+            while (a < mid && b < hi) {
+                tmp[k++] = p[order[b]].arrival < p[order[a]].arrival ? order[b++] : order[a++];
+            }
+            while (a < mid) tmp[k++] = order[a++];
+            while (b < hi) tmp[k++] = order[b++];
+        }
+        int *swap = order;
+        order = tmp;
+        tmp = swap;
+    }
+
+    free(tmp);
+    return order;
+}
+
+// Shortest Remaining Time First, one time unit at a time with a linear scan (as in 5.c)
+void srtfScheduling(struct Process p[], int n) {
+    int completed = 0, currentTime = 0, shortestProcess;
+    int minBurst;
+
+    while (completed != n) {
+        shortestProcess = -1;
+        minBurst = INT_MAX;
+
+        // Find process with the shortest remaining burst time at the current time
+        for (int i = 0; i < n; i++) {
+            if (p[i].arrival <= currentTime && p[i].remaining > 0 && p[i].remaining < minBurst) {
+                minBurst = p[i].remaining;
+                shortestProcess = i;
+            }
+        }
+
+        if (shortestProcess == -1) {
+            currentTime++;
+            continue;
+        }
+        decisions++;
+
+        // Process the selected shortest job
+        recordRun(p[shortestProcess].pid, currentTime, currentTime + 1);
+        p[shortestProcess].remaining--;
+        currentTime++;
+
+        if (p[shortestProcess].remaining == 0) {
+            finishProcess(&p[shortestProcess], currentTime);
+            completed++;
+        }
+    }
+}
+
+// Round Robin with a FIFO ready queue, admitting arrivals before requeueing the current process
+void roundRobinScheduling(struct Process p[], int n, int timeQuantum) {
+    int *order = sortByArrival(p, n);
+    int *queue = malloc(n * sizeof(int));
+    int front = 0, size = 0;
+    int next = 0; // Next process (in arrival order) to admit
+    int currentTime = 0, completed = 0;
+
+    while (completed != n) {
+        // Add all processes that have arrived by the current time to the queue
+        while (next < n && p[order[next]].arrival <= currentTime) {
+            queue[(front + size++) % n] = order[next++];
+        }
+
+        // CPU is idle until the next arrival
+        if (size == 0) {
+            currentTime = p[order[next]].arrival;
+            continue;
+        }
+
+        int processIndex = queue[front];
+        front = (front + 1) % n;
+        size--;
+        decisions++;
+
+        int start = currentTime;
+        if (p[processIndex].remaining > timeQuantum) {
+            currentTime += timeQuantum;
+            p[processIndex].remaining -= timeQuantum;
+        } else {
+            currentTime += p[processIndex].remaining;
+            finishProcess(&p[processIndex], currentTime);
+            completed++;
+        }
+        recordRun(p[processIndex].pid, start, currentTime);
+
+        while (next < n && p[order[next]].arrival <= currentTime) {
+            queue[(front + size++) % n] = order[next++];
+        }
+
+        // Re-add the current process to the queue if it is not finished
+        if (p[processIndex].remaining > 0) {
+            queue[(front + size++) % n] = processIndex;
+        }
+    }
+
+    free(queue);
+    free(order);
+}
+
+// Order processes by vruntime, breaking ties by PID so keys are unique
+int entityBefore(struct Process *a, struct Process *b) {
+    if (a->vruntime != b->vruntime) {
+        return a->vruntime < b->vruntime;
+    }
+    return a->pid < b->pid;
+}
+
+void rqInit(struct RunQueue *rq) {
+    memset(rq, 0, sizeof(*rq));
+    rq->nil.color = RB_BLACK;
+    rq->root = &rq->nil;
+    rq->leftmost = NULL;
+}
+
+void rbRotateLeft(struct RunQueue *rq, struct Process *x) {
+    struct Process *y = x->right;
+
+    x->right = y->left;
+    if (y->left != &rq->nil) {
+        y->left->parent = x;
+    }
+    y->parent = x->parent;
+    if (x->parent == &rq->nil) {
+        rq->root = y;
+    } else if (x == x->parent->left) {
+        x->parent->left = y;
+    } else {
+        x->parent->right = y;
+    }
+    y->left = x;
+    x->parent = y;
+}
+
+void rbRotateRight(struct RunQueue *rq, struct Process *x) {
+    struct Process *y = x->left;
+
+    x->left = y->right;
+    if (y->right != &rq->nil) {
+        y->right->parent = x;
+    }
+    y->parent = x->parent;
+    if (x->parent == &rq->nil) {
+        rq->root = y;
+    } else if (x == x->parent->right) {
+        x->parent->right = y;
+    } else {
+        x->parent->left = y;
+    }
+    y->right = x;
+    x->parent = y;
+}
+
+void rbInsertFixup(struct RunQueue *rq, struct Process *z) {
+    while (z->parent->color == RB_RED) {
+        struct Process *g = z->parent->parent;
+        if (z->parent == g->left) {
+            struct Process *uncle = g->right;
+            if (uncle->color == RB_RED) {
+                z->parent->color = RB_BLACK;
+                uncle->color = RB_BLACK;
+                g->color = RB_RED;
+                z = g;
+            } else {
+                if (z == z->parent->right) {
+                    z = z->parent;
+                    rbRotateLeft(rq, z);
+                }
+                z->parent->color = RB_BLACK;
+                z->parent->parent->color = RB_RED;
+                rbRotateRight(rq, z->parent->parent);
+            }
+        } else {
+            struct Process *uncle = g->left;
+            if (uncle->color == RB_RED) {
+                z->parent->color = RB_BLACK;
+                uncle->color = RB_BLACK;
+                g->color = RB_RED;
+                z = g;
+            } else {
+                if (z == z->parent->left) {
+                    z = z->parent;
+                    rbRotateRight(rq, z);
+                }
+                z->parent->color = RB_BLACK;
+                z->parent->parent->color = RB_RED;
+                rbRotateLeft(rq, z->parent->parent);
+            }
+        }
+    }
+    rq->root->color = RB_BLACK;
+}
+
+// Insert a runnable process, O(log n)
+void rqEnqueue(struct RunQueue *rq, struct Process *z) {
+    struct Process *y = &rq->nil;
+    struct Process *x = rq->root;
+    int leftmost = 1;
+
+    while (x != &rq->nil) {
+        y = x;
+        if (entityBefore(z, x)) {
+            x = x->left;
+        } else {
+            x = x->right;
+            leftmost = 0;
+        }
+    }
+
+    z->parent = y;
+    if (y == &rq->nil) {
+        rq->root = z;
+    } else if (entityBefore(z, y)) {
+        y->left = z;
+    } else {
+        y->right = z;
+    }
+    z->left = &rq->nil;
+    z->right = &rq->nil;
+    z->color = RB_RED;
+    rbInsertFixup(rq, z);
+
+    if (leftmost) {
+        rq->leftmost = z;
+    }
+    rq->count++;
+    rq->totalWeight += z->weight;
+}
+
+void rbTransplant(struct RunQueue *rq, struct Process *u, struct Process *v) {
+    if (u->parent == &rq->nil) {
+        rq->root = v;
+    } else if (u == u->parent->left) {
+        u->parent->left = v;
+    } else {
+        u->parent->right = v;
+    }
+    v->parent = u->parent;
+}
+
+struct Process *rbMinimum(struct RunQueue *rq, struct Process *x) {
+    while (x->left != &rq->nil) {
+        x = x->left;
+    }
+    return x;
+}
+
+void rbDeleteFixup(struct RunQueue *rq, struct Process *x) {
+    while (x != rq->root && x->color == RB_BLACK) {
+        if (x == x->parent->left) {
+            struct Process *w = x->parent->right;
+            if (w->color == RB_RED) {
+                w->color = RB_BLACK;
+                x->parent->color = RB_RED;
+                rbRotateLeft(rq, x->parent);
+                w = x->parent->right;
+            }
+            if (w->left->color == RB_BLACK && w->right->color == RB_BLACK) {
+                w->color = RB_RED;
+                x = x->parent;
+            } else {
+                if (w->right->color == RB_BLACK) {
+                    w->left->color = RB_BLACK;
+                    w->color = RB_RED;
+                    rbRotateRight(rq, w);
+                    w = x->parent->right;
+                }
+                w->color = x->parent->color;
+                x->parent->color = RB_BLACK;
+                w->right->color = RB_BLACK;
+                rbRotateLeft(rq, x->parent);
+                x = rq->root;
+            }
+        } else {
+            struct Process *w = x->parent->left;
+            if (w->color == RB_RED) {
+                w->color = RB_BLACK;
+                x->parent->color = RB_RED;
+                rbRotateRight(rq, x->parent);
+                w = x->parent->left;
+            }
+            if (w->right->color == RB_BLACK && w->left->color == RB_BLACK) {
+                w->color = RB_RED;
+                x = x->parent;
+            } else {
+                if (w->left->color == RB_BLACK) {
+                    w->right->color = RB_BLACK;
+                    w->color = RB_RED;
+                    rbRotateLeft(rq, w);
+                    w = x->parent->left;
+                }
+                w->color = x->parent->color;
+                x->parent->color = RB_BLACK;
+                w->left->color = RB_BLACK;
+                rbRotateRight(rq, x->parent);
+                x = rq->root;
+            }
+        }
+    }
+    x->color = RB_BLACK;
+}
+
+// Remove a process from the runqueue, O(log n)
+void rqDequeue(struct RunQueue *rq, struct Process *z) {
+    struct Process *y = z;
+    struct Process *x;
+    int originalColor = y->color;
+
+    if (rq->leftmost == z) {
+        // The leftmost node has no left child, so its successor is close by
+        rq->leftmost = z->right != &rq->nil ? rbMinimum(rq, z->right) : z->parent;
+        if (rq->leftmost == &rq->nil) {
+            rq->leftmost = NULL;
+        }
+    }
+
+    if (z->left == &rq->nil) {
+        x = z->right;
+        rbTransplant(rq, z, z->right);
+    } else if (z->right == &rq->nil) {
+        x = z->left;
+        rbTransplant(rq, z, z->left);
+    } else {
+        y = rbMinimum(rq, z->right);
+        originalColor = y->color;
+        x = y->right;
+        if (y->parent == z) {
+            x->parent = y;
+        } else {
+            rbTransplant(rq, y, y->right);
+            y->right = z->right;
+            y->right->parent = y;
+        }
+        rbTransplant(rq, z, y);
+        y->left = z->left;
+        y->left->parent = y;
+        y->color = z->color;
+    }
+    if (originalColor == RB_BLACK) {
+        rbDeleteFixup(rq, x);
+    }
+
+    rq->count--;
+    rq->totalWeight -= z->weight;
+}
+
+// Advance min_vruntime monotonically towards the smallest runnable vruntime
+void updateMinVruntime(struct RunQueue *rq, struct Process *curr) {
+    long long vruntime = curr ? curr->vruntime : rq->minVruntime;
+
+    if (rq->leftmost && (!curr || rq->leftmost->vruntime < vruntime)) {
+        vruntime = rq->leftmost->vruntime;
+    }
+    if (vruntime > rq->minVruntime) {
+        rq->minVruntime = vruntime;
+    }
+}
+
+// Weighted runtime: heavier (lower nice) processes accumulate vruntime more slowly
+long long calcDeltaFair(int delta, int weight) {
+    return (long long)delta * NICE_0_LOAD * VRUNTIME_SCALE / weight;
+}
+
+// Completely Fair Scheduler: always run the process with the smallest vruntime for a
+// slice proportional to its share of the total runnable weight
+void cfsScheduling(struct Process p[], int n) {
+    int *order = sortByArrival(p, n);
+    struct RunQueue rq;
+    int next = 0, currentTime = 0, completed = 0;
+
+    rqInit(&rq);
+    for (int i = 0; i < n; i++) {
+        p[i].weight = niceToWeight[p[i].nice + 20];
+        p[i].vruntime = 0;
+    }
+
+    while (completed != n) {
+        // Newly arrived processes start at min_vruntime so they cannot monopolise the CPU
+        while (next < n && p[order[next]].arrival <= currentTime) {
+            struct Process *arrived = &p[order[next++]];
+            if (arrived->vruntime < rq.minVruntime) {
+                arrived->vruntime = rq.minVruntime;
+            }
+            rqEnqueue(&rq, arrived);
+        }
+
+        // CPU is idle until the next arrival
+        if (rq.count == 0) {
+            currentTime = p[order[next]].arrival;
+            continue;
+        }
+
+        // Pick next: the leftmost process leaves the tree while it runs
+        struct Process *curr = rq.leftmost;
+        long long weight = rq.totalWeight;
+        rqDequeue(&rq, curr);
+        decisions++;
+
+        int slice = (int)(SCHED_LATENCY * (long long)curr->weight / weight);
+        if (slice < MIN_GRANULARITY) {
+            slice = MIN_GRANULARITY;
+        }
+        int run = curr->remaining < slice ? curr->remaining : slice;
+
+        // An arrival ends the slice early so the newcomer is considered at once (like a tick)
+        if (next < n && p[order[next]].arrival - currentTime < run) {
+            run = p[order[next]].arrival - currentTime;
+        }
+
+        recordRun(curr->pid, currentTime, currentTime + run);
+        currentTime += run;
+        curr->remaining -= run;
+        curr->vruntime += calcDeltaFair(run, curr->weight);
+
+        if (curr->remaining == 0) {
+            finishProcess(curr, currentTime);
+            updateMinVruntime(&rq, NULL);
+            completed++;
+        } else {
+            updateMinVruntime(&rq, curr);
+            rqEnqueue(&rq, curr);
+        }
+    }
+
+    free(order);
+}
+
+// Append a process to the tail of its level and mark the level non-empty, O(1)
+void mlfqEnqueue(struct MlfqQueue *mq, struct Process *proc, int level) {
+    proc->level = level;
+    proc->next = NULL;
+    if (mq->tail[level]) {
+        mq->tail[level]->next = proc;
+    } else {
+        mq->head[level] = proc;
+    }
+    mq->tail[level] = proc;
+    mq->bitmap |= 1ULL << level;
+}
+
+// Pop the head of the highest-priority non-empty level with find-first-set, O(1)
+struct Process *mlfqPickNext(struct MlfqQueue *mq) {
+    int level = __builtin_ctzll(mq->bitmap);
+    struct Process *proc = mq->head[level];
+
+    mq->head[level] = proc->next;
+    if (!mq->head[level]) {
+        mq->tail[level] = NULL;
+        mq->bitmap &= ~(1ULL << level);
+    }
+    proc->level = level; // Splicing during a boost leaves the stored level stale
+    return proc;
+}
+
+// Priority boost: splice every lower level onto level 0 in O(levels)
+void mlfqBoost(struct MlfqQueue *mq, int levels) {
+    for (int level = 1; level < levels; level++) {
+        if (!mq->head[level]) {
+            continue;
+        }
+        if (mq->tail[0]) {
+            mq->tail[0]->next = mq->head[level];
+        } else {
+            mq->head[0] = mq->head[level];
+        }
+        mq->tail[0] = mq->tail[level];
+        mq->head[level] = NULL;
+        mq->tail[level] = NULL;
+    }
+    mq->bitmap = mq->head[0] ? 1 : 0;
+}
+
+// Multi-Level Feedback Queue: run the highest non-empty level round robin, demote a
+// process once it uses up its level's quantum and periodically boost everyone to level 0
+void mlfqScheduling(struct Process p[], int n) {
+    int *order = sortByArrival(p, n);
+    struct MlfqQueue mq;
+    int next = 0, currentTime = 0, completed = 0, runnable = 0;
+    int epoch = 0, nextBoost = boostPeriod;
+
+    memset(&mq, 0, sizeof(mq));
+    for (int i = 0; i < n; i++) {
+        p[i].used = 0;
+        p[i].boostEpoch = 0;
+    }
+
+    while (completed != n) {
+        if (boostPeriod > 0 && currentTime >= nextBoost) {
+            mlfqBoost(&mq, mlfqLevels);
+            epoch++;
+            while (nextBoost <= currentTime) {
+                nextBoost += boostPeriod;
+            }
+        }
+
+        // New processes enter at the highest priority
+        while (next < n && p[order[next]].arrival <= currentTime) {
+            struct Process *arrived = &p[order[next++]];
+            arrived->boostEpoch = epoch;
+            mlfqEnqueue(&mq, arrived, 0);
+            runnable++;
+        }
+
+        // CPU is idle until the next arrival
+        if (runnable == 0) {
+            currentTime = p[order[next]].arrival;
+            continue;
+        }
+
+        struct Process *curr = mlfqPickNext(&mq);
+        decisions++;
+
+        if (curr->boostEpoch != epoch) {
+            curr->used = 0;
+            curr->boostEpoch = epoch;
+        }
+
+        int level = curr->level;
+        int run = mlfqQuantum[level] - curr->used;
+        if (curr->remaining < run) {
+            run = curr->remaining;
+        }
+        // Below level 0 an arrival preempts, since it outranks the running process
+        if (level > 0 && next < n && p[order[next]].arrival - currentTime < run) {
+            run = p[order[next]].arrival - currentTime;
+        }
+
+        recordRun(curr->pid, currentTime, currentTime + run);
+        currentTime += run;
+        curr->remaining -= run;
+        curr->used += run;
+
+        if (curr->remaining == 0) {
+            finishProcess(curr, currentTime);
+            runnable--;
+            completed++;
+            continue;
+        }
+
+        // Admit arrivals first so a demoted process queues behind them
+        while (next < n && p[order[next]].arrival <= currentTime) {
+            struct Process *arrived = &p[order[next++]];
+            arrived->boostEpoch = epoch;
+            mlfqEnqueue(&mq, arrived, 0);
+            runnable++;
+        }
+
+        if (curr->used >= mlfqQuantum[level]) {
+            // Quantum used up: demote, keeping the lowest level round robin
+            curr->used = 0;
+            mlfqEnqueue(&mq, curr, level + 1 < mlfqLevels ? level + 1 : level);
+        } else {
+            mlfqEnqueue(&mq, curr, level);
+        }
+    }
+
+    free(order);
+}
+
+// Fill in the default MLFQ levels (q, 2q, 4q) when -L was not given
+void setupMlfq(int timeQuantum) {
+    if (mlfqLevels > 0) {
+        return;
+    }
+    mlfqLevels = 3;
+    for (int level = 0; level < mlfqLevels; level++) {
+        mlfqQuantum[level] = timeQuantum << level;
+    }
+}
+
+// Parse a comma separated list of per-level quanta
+int parseLevels(const char *list) {
+    char *copy = strdup(list);
+    int levels = 0;
+
+    for (char *tok = strtok(copy, ","); tok; tok = strtok(NULL, ",")) {
+        if (levels == MLFQ_MAX_LEVELS || atoi(tok) <= 0) {
+            free(copy);
+            return 0;
+        }
+        mlfqQuantum[levels++] = atoi(tok);
+    }
+    free(copy);
+    mlfqLevels = levels;
+    return levels;
+}
+
+void printStats(const char *name, const struct RunningStats *st) {
+    printf("%s\t%.2f\t%.2f\t%lld\t%lld\t%.0f\t%.0f\t%.0f\t%.0f\n", name, statsMean(st), statsStddev(st),
+           st->min, st->max, statsQuantile(st, 0.5), statsQuantile(st, 0.9), statsQuantile(st, 0.99),
+           statsQuantile(st, 0.999));
+}
+
+// Summarise the streamed results; per-process rows were printed as each process completed
+void printResults() {
+    printf("\nAverage Turnaround Time: %.2f", statsMean(&turnaroundStats));
+    printf("\nAverage Waiting Time: %.2f\n", statsMean(&waitingStats));
+
+    printf("\n\t\tMean\tStddev\tMin\tMax\tp50\tp90\tp99\tp99.9\n");
+    printStats("Turnaround", &turnaroundStats);
+    printStats("Waiting\t", &waitingStats);
+}
+
+void runPolicy(const char *policy, struct Process p[], int n, int timeQuantum) {
+    decisions = 0;
+    statsInit(&turnaroundStats);
+    statsInit(&waitingStats);
+    if (streamResults) {
+        printf("\nProcess\tArrival\tBurst\tNice\tCompletion\tTurnaround\tWaiting\n");
+    }
+    if (strcmp(policy, "rr") == 0) {
+        roundRobinScheduling(p, n, timeQuantum);
+    } else if (strcmp(policy, "cfs") == 0) {
+        cfsScheduling(p, n);
+    } else if (strcmp(policy, "mlfq") == 0) {
+        mlfqScheduling(p, n);
+    } else {
+        srtfScheduling(p, n);
+    }
+}
+
+// Random workload: arrivals packed into [0, n) so most processes are runnable at once
+void generateProcesses(struct Process p[], int n) {
+    for (int i = 0; i < n; i++) {
+        memset(&p[i], 0, sizeof(p[i]));
+        p[i].pid = i + 1;
+        p[i].arrival = rand() % n;
+        p[i].burst = 1 + rand() % 100;
+        p[i].remaining = p[i].burst;
+        p[i].nice = rand() % 40 - 20;
+    }
+}
+
+double benchmarkPolicy(const char *policy, int n, int timeQuantum, int showResults) {
+    struct Process *p = malloc(n * sizeof(struct Process));
+
+    srand(n);
+    generateProcesses(p, n);
+
+    double start = nowSeconds();
+    runPolicy(policy, p, n, timeQuantum);
+    double elapsed = nowSeconds() - start;
+
+    if (showResults) {
+        printResults();
+    }
+    free(p);
+    return elapsed;
+}
+
+void scalingBenchmark(int timeQuantum) {
+    const char *policies[] = {"srtf", "rr", "cfs", "mlfq", "mlfq"};
+    const char *labels[] = {"srtf", "rr", "cfs", "mlfq", "mlfq-s0"};
+    // SRTF rescans every process on every tick, so it is only run on the smaller sizes
+    const int maxProcesses[] = {10000, 1000000, 1000000, 1000000, 1000000};
+    // With thousands of runnable processes a process waits far longer than the boost period
+    // between two turns, so every boost puts it back on level 0 before it is ever demoted and the
+    // mlfq row schedules like rr. The mlfq-s0 row turns boosting off so that processes sink
+    // through the levels and the bitmap picks among several non-empty ones.
+    const int boostPeriods[] = {boostPeriod, boostPeriod, boostPeriod, boostPeriod, 0};
+    int savedBoost = boostPeriod;
+
+    printf("Policy\tProcesses\tSeconds\t\tDecisions\tDecisions/sec\n");
+    for (int k = 0; k < 5; k++) {
+        boostPeriod = boostPeriods[k];
+        for (int n = 1000; n <= maxProcesses[k]; n *= 10) {
+            double elapsed = benchmarkPolicy(policies[k], n, timeQuantum, 0);
+            printf("%s\t%d\t\t%.4f\t\t%lld\t%.0f\n", labels[k], n, elapsed, decisions,
+                   decisions / elapsed);
+        }
+    }
+    boostPeriod = savedBoost;
+}
+
+int main(int argc, char *argv[]) {
+    const char *policy = "srtf";
+    int timeQuantum = 0;
+    int benchmarkSize = 0;
+    int scaling = 0;
+    const char *timelinePath = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:q:L:s:b:Bt:j:")) != -1) {
+        switch (opt) {
+        case 'p':
+            policy = optarg;
+            break;
+        case 'q':
+            timeQuantum = atoi(optarg);
+            break;
+        case 'L':
+            if (!parseLevels(optarg)) {
+                fprintf(stderr, "Invalid level list: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 's':
+            boostPeriod = atoi(optarg);
+            break;
+        case 'b':
+            benchmarkSize = atoi(optarg);
+            break;
+        case 'B':
+            scaling = 1;
+            break;
+        case 't':
+            timelinePath = optarg;
+            break;
+        case 'j':
+            return convertTimeline(optarg);
+        default:
+            fprintf(stderr, "Usage: %s [-p srtf|rr|cfs|mlfq] [-q quantum] [-L q0,q1,...] [-s period] "
+                            "[-b processes] [-B] [-t timeline.bin] [-j timeline.bin]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (strcmp(policy, "srtf") != 0 && strcmp(policy, "rr") != 0 && strcmp(policy, "cfs") != 0 &&
+        strcmp(policy, "mlfq") != 0) {
+        fprintf(stderr, "Unknown policy: %s\n", policy);
+        return 1;
+    }
+    if ((benchmarkSize > 0 || scaling || strcmp(policy, "mlfq") == 0) && timeQuantum <= 0) {
+        timeQuantum = 4;
+    }
+    setupMlfq(timeQuantum);
+
+    if (scaling) {
+        scalingBenchmark(timeQuantum);
+        return 0;
+    }
+    if (timelinePath && !timelineOpen(timelinePath)) {
+        return 1;
+    }
+
+    if (benchmarkSize > 0) {
+        double elapsed = benchmarkPolicy(policy, benchmarkSize, timeQuantum, 1);
+        printf("\n%s: %d processes in %.4f s, %lld decisions (%.0f decisions/sec)\n", policy,
+               benchmarkSize, elapsed, decisions, decisions / elapsed);
+        if (!timelineClose()) {
+            return 1;
+        }
+        if (timelinePath) {
+            printf("Timeline: %lld segments written to %s\n", timeline.segments, timelinePath);
+        }
+        return 0;
+    }
+
+    int n;
+    printf("Enter the number of processes: ");
+    scanf("%d", &n);
+
+    struct Process *p = calloc(n, sizeof(struct Process));
+
+    // Input process details
+    for (int i = 0; i < n; i++) {
+        p[i].pid = i + 1;
+        if (strcmp(policy, "cfs") == 0) {
+            printf("Enter arrival time, burst time and nice value for process P%d: ", p[i].pid);
+            scanf("%d%d%d", &p[i].arrival, &p[i].burst, &p[i].nice);
+            if (p[i].nice < -20) p[i].nice = -20;
+            if (p[i].nice > 19) p[i].nice = 19;
+        } else {
+            printf("Enter arrival time and burst time for process P%d: ", p[i].pid);
+            scanf("%d%d", &p[i].arrival, &p[i].burst);
+        }
+        p[i].remaining = p[i].burst;
+        p[i].finished = 0;
+    }
+
+    if (strcmp(policy, "rr") == 0 && timeQuantum <= 0) {
+        printf("Enter time quantum: ");
+        scanf("%d", &timeQuantum);
+    }
+
+    streamResults = 1;
+    runPolicy(policy, p, n, timeQuantum);
+    int written = timelineClose();
+    printResults();
+
+    free(p);
+    return written ? 0 : 1;
+}
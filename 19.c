@@ -0,0 +1,399 @@
+// Implement a user-space green-thread executor that runs real work items as ucontext threads on
+// one OS thread. A timer signal preempts the running thread and the next one is chosen by the
+// Shortest Remaining Time First or Round Robin policy. Compare its context-switch latency and
+// throughput against running the same work on plain pthreads, pinned to the same single CPU.
+//
+// Compile: gcc -O2 19.c -o green_exec -lpthread
+// Usage:   ./green_exec [-p srtf|rr] [-n tasks] [-w max work units] [-t timer us] [-s switches]
+//            -p  scheduling policy for the green threads (default srtf)
+//            -n  number of work items (default 100)
+//            -w  largest work item in units of about a microsecond (default 20000)
+//            -t  preemption timer interval in microseconds (default 1000)
+//            -s  round trips for the context-switch latency test (default 200000)
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/time.h>
+
+#define STACK_SIZE (64 * 1024)
+#define UNIT_ITERATIONS 600 // Loop iterations in one unit of work
+
+struct GreenThread {
+    int id;
+    ucontext_t ctx;
+    char *stack;
+    long work;              // Units of work in this item
+    long done;              // Units completed so far
+    int finished;           // Is the work item finished
+    double completion;      // Seconds from the start of the run until it finished
+    struct GreenThread *next; // Round Robin ready queue link
+};
+
+int executorCpu;                     // CPU every executor and both switch-latency tests run on
+ucontext_t schedulerCtx;             // Context of the scheduler loop
+struct GreenThread *current = NULL;  // Green thread running right now
+volatile sig_atomic_t needResched = 0; // Set by the timer, checked at preemption points
+volatile unsigned long sink;         // Keeps the work loop from being optimised away
+
+long contextSwitches = 0; // Dispatches from the scheduler into a green thread
+long preemptions = 0;     // Yields forced by the timer
+
+double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void timerHandler(int sig) {
+    (void)sig;
+    needResched = 1;
+}
+
+// Arm (or with 0 disarm) the periodic preemption timer
+void setTimer(long intervalUs) {
+    struct itimerval it;
+
+    it.it_interval.tv_sec = intervalUs / 1000000;
+    it.it_interval.tv_usec = intervalUs % 1000000;
+    it.it_value = it.it_interval;
+    setitimer(ITIMER_REAL, &it, NULL);
+}
+
+// One unit of CPU-bound work
+void doUnit(unsigned long *state) {
+    unsigned long x = *state;
+    for (int i = 0; i < UNIT_ITERATIONS; i++) {
+        x = x * 6364136223846793005UL + 1442695040888963407UL;
+    }
+    *state = x;
+}
+
+// Give the CPU back to the scheduler
+void greenYield() {
+    swapcontext(&current->ctx, &schedulerCtx);
+}
+
+// Body of every green thread. The timer only raises a flag; the switch happens at the next
+// unit boundary, because swapping contexts inside a signal handler is not async-signal-safe.
+void greenEntry(int lo, int hi) {
+    struct GreenThread *t = (struct GreenThread *)(((unsigned long)(unsigned)hi << 32) | (unsigned)lo);
+    unsigned long state = t->id;
+
+    while (t->done < t->work) {
+        doUnit(&state);
+        t->done++;
+        if (needResched) {
+            preemptions++;
+            greenYield();
+        }
+    }
+    sink = state;
+    t->finished = 1;
+    // Returning resumes the scheduler through uc_link
+}
+
+void greenCreate(struct GreenThread *t, void (*entry)(int, int)) {
+    unsigned long addr = (unsigned long)t;
+
+    t->stack = malloc(STACK_SIZE);
+    getcontext(&t->ctx);
+    t->ctx.uc_stack.ss_sp = t->stack;
+    t->ctx.uc_stack.ss_size = STACK_SIZE;
+    t->ctx.uc_link = &schedulerCtx;
+    makecontext(&t->ctx, (void (*)(void))entry, 2, (int)(addr & 0xffffffffUL), (int)(addr >> 32));
+}
+
+// SRTF: the unfinished work item with the fewest units left (linear scan, as in 5.c)
+struct GreenThread *pickSrtf(struct GreenThread t[], int n) {
+    struct GreenThread *best = NULL;
+
+    for (int i = 0; i < n; i++) {
+        if (!t[i].finished && (!best || t[i].work - t[i].done < best->work - best->done)) {
+            best = &t[i];
+        }
+    }
+    return best;
+}
+
+// Run every work item to completion on this OS thread
+double runGreen(struct GreenThread t[], int n, int srtf, long timerUs) {
+    struct GreenThread *head = NULL, *tail = NULL;
+    struct sigaction sa;
+    int completed = 0;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = timerHandler;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGALRM, &sa, NULL);
+
+    for (int i = 0; i < n; i++) {
+        greenCreate(&t[i], greenEntry);
+        if (tail) tail->next = &t[i]; else head = &t[i];
+        tail = &t[i];
+        t[i].next = NULL;
+    }
+
+    double start = nowSeconds();
+    setTimer(timerUs);
+
+    while (completed != n) {
+        if (srtf) {
+            current = pickSrtf(t, n);
+        } else {
+            current = head;
+            head = head->next;
+            if (!head) tail = NULL;
+        }
+
+        needResched = 0;
+        contextSwitches++;
+        swapcontext(&schedulerCtx, &current->ctx);
+
+        if (current->finished) {
+            current->completion = nowSeconds() - start;
+            completed++;
+        } else if (!srtf) {
+            // Preempted: back to the tail of the ready queue
+            current->next = NULL;
+            if (tail) tail->next = current; else head = current;
+            tail = current;
+        }
+    }
+
+    setTimer(0);
+    double elapsed = nowSeconds() - start;
+
+    for (int i = 0; i < n; i++) {
+        free(t[i].stack);
+    }
+    return elapsed;
+}
+
+struct PthreadTask {
+    struct GreenThread *t;
+    double start;
+};
+
+void *pthreadEntry(void *arg) {
+    struct PthreadTask *task = arg;
+    unsigned long state = task->t->id;
+
+    while (task->t->done < task->t->work) {
+        doUnit(&state);
+        task->t->done++;
+    }
+    sink = state;
+    task->t->completion = nowSeconds() - task->start;
+    return NULL;
+}
+
+// Attributes for a thread that may only run on executorCpu
+void pinnedAttr(pthread_attr_t *attr) {
+    cpu_set_t cpus;
+
+    CPU_ZERO(&cpus);
+    CPU_SET(executorCpu, &cpus);
+    pthread_attr_init(attr);
+    pthread_attr_setaffinity_np(attr, sizeof(cpus), &cpus);
+}
+
+// Same work, one kernel thread per item, scheduled by the OS. The threads are pinned to the CPU
+// the green threads ran on; left free, they would spread over every core and the comparison would
+// be n cores against one.
+double runPthreads(struct GreenThread t[], int n) {
+    pthread_t *threads = malloc(n * sizeof(pthread_t));
+    struct PthreadTask *tasks = malloc(n * sizeof(struct PthreadTask));
+    pthread_attr_t attr;
+    pinnedAttr(&attr);
+    double start = nowSeconds();
+
+    for (int i = 0; i < n; i++) {
+        tasks[i].t = &t[i];
+        tasks[i].start = start;
+        pthread_create(&threads[i], &attr, pthreadEntry, &tasks[i]);
+    }
+    for (int i = 0; i < n; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed = nowSeconds() - start;
+
+    pthread_attr_destroy(&attr);
+    free(threads);
+    free(tasks);
+    return elapsed;
+}
+
+void makeWork(struct GreenThread t[], int n, long maxWork) {
+    srand(42);
+    for (int i = 0; i < n; i++) {
+        memset(&t[i], 0, sizeof(t[i]));
+        t[i].id = i + 1;
+        t[i].work = 1 + rand() % maxWork;
+    }
+}
+
+void printRun(const char *name, struct GreenThread t[], int n, double elapsed) {
+    double totalTurnaround = 0;
+    long totalWork = 0;
+
+    for (int i = 0; i < n; i++) {
+        totalTurnaround += t[i].completion;
+        totalWork += t[i].work;
+    }
+    printf("%-16s %10.4f %14.0f %14.0f %18.2f\n", name, elapsed, n / elapsed, totalWork / elapsed,
+           totalTurnaround / n * 1000);
+}
+
+long pingPongRounds;
+long pingPongLeft;
+
+void pingPongEntry(int lo, int hi) {
+    (void)lo;
+    (void)hi;
+    while (pingPongLeft > 0) {
+        pingPongLeft--;
+        swapcontext(&current->ctx, &schedulerCtx);
+    }
+}
+
+// Green switch latency: a thread yields to the scheduler, which resumes it (two switches)
+double greenSwitchLatency(long rounds) {
+    struct GreenThread t;
+
+    memset(&t, 0, sizeof(t));
+    greenCreate(&t, pingPongEntry);
+    current = &t;
+    pingPongLeft = rounds;
+
+    double start = nowSeconds();
+    while (pingPongLeft > 0) {
+        swapcontext(&schedulerCtx, &t.ctx);
+    }
+    double elapsed = nowSeconds() - start;
+
+    free(t.stack);
+    return elapsed / (2.0 * rounds) * 1e9;
+}
+
+sem_t ping, pong;
+
+void *pongThread(void *arg) {
+    (void)arg;
+    for (long i = 0; i < pingPongRounds; i++) {
+        sem_wait(&ping);
+        sem_post(&pong);
+    }
+    return NULL;
+}
+
+// Kernel switch latency: two pthreads on the same CPU hand a token back and forth through
+// semaphores
+double pthreadSwitchLatency(long rounds) {
+    pthread_t thread;
+    pthread_attr_t attr;
+
+    sem_init(&ping, 0, 0);
+    sem_init(&pong, 0, 0);
+    pingPongRounds = rounds;
+    pinnedAttr(&attr);
+    pthread_create(&thread, &attr, pongThread, NULL);
+    pthread_attr_destroy(&attr);
+
+    double start = nowSeconds();
+    for (long i = 0; i < rounds; i++) {
+        sem_post(&ping);
+        sem_wait(&pong);
+    }
+    double elapsed = nowSeconds() - start;
+
+    pthread_join(thread, NULL);
+    sem_destroy(&ping);
+    sem_destroy(&pong);
+    return elapsed / (2.0 * rounds) * 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    const char *policy = "srtf";
+    int n = 100;
+    long maxWork = 20000;
+    long timerUs = 1000;
+    long rounds = 200000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:n:w:t:s:")) != -1) {
+        switch (opt) {
+        case 'p':
+            policy = optarg;
+            break;
+        case 'n':
+            n = atoi(optarg);
+            break;
+        case 'w':
+            maxWork = atol(optarg);
+            break;
+        case 't':
+            timerUs = atol(optarg);
+            break;
+        case 's':
+            rounds = atol(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-p srtf|rr] [-n tasks] [-w max work units] [-t timer us] "
+                            "[-s switches]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (strcmp(policy, "srtf") != 0 && strcmp(policy, "rr") != 0) {
+        fprintf(stderr, "Unknown policy: %s\n", policy);
+        return 1;
+    }
+    if (n <= 0 || maxWork <= 0 || timerUs <= 0 || rounds <= 0) {
+        fprintf(stderr, "Task count, work, timer and switch count must be positive\n");
+        return 1;
+    }
+
+    // Run everything on the CPU this thread started on, so that green threads and pthreads get
+    // exactly one core each
+    executorCpu = sched_getcpu();
+    if (executorCpu < 0) {
+        executorCpu = 0;
+    }
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(executorCpu, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+
+    struct GreenThread *t = malloc(n * sizeof(struct GreenThread));
+
+    printf("%d work items of up to %ld units, %ld us preemption timer, all on CPU %d\n\n", n, maxWork,
+           timerUs, executorCpu);
+    printf("%-16s %10s %14s %14s %18s\n", "Executor", "Seconds", "Items/sec", "Units/sec",
+           "Avg turnaround ms");
+
+    makeWork(t, n, maxWork);
+    double elapsed = runGreen(t, n, strcmp(policy, "srtf") == 0, timerUs);
+    char name[32];
+    snprintf(name, sizeof(name), "green (%s)", policy);
+    printRun(name, t, n, elapsed);
+    long greenSwitches = contextSwitches, greenPreemptions = preemptions;
+
+    makeWork(t, n, maxWork);
+    elapsed = runPthreads(t, n);
+    printRun("pthreads", t, n, elapsed);
+
+    printf("\nGreen run: %ld context switches, %ld timer preemptions\n", greenSwitches, greenPreemptions);
+    printf("Context switch latency: green %.1f ns, pthread %.1f ns\n", greenSwitchLatency(rounds),
+           pthreadSwitchLatency(rounds));
+
+    free(t);
+    return 0;
+}
@@ -0,0 +1,1221 @@
+// Measure the throughput of the producer-consumer bounded buffer from 7.c. The original path
+// (counting semaphores and a mutex) is compared with a lock-free single-producer/single-consumer
+// ring built on acquire/release atomics and a bounded lock-free multi-producer/multi-consumer
+// queue, with the sleep() calls removed and any number of producer and consumer threads.
+//
+// Compile: gcc -O2 20.c -o prodcons -lpthread -lm
+// Usage:   ./prodcons [-m sem|spsc|mpmc] [-n items] [-s slots] [-z item bytes] [-P producers] [-C consumers]
+//                     [-a] [-S] [-b batch] [-A] [-w spin|adaptive|block] [-L interval us] [-T trials] [-W warm-up]
+//            -m  queue implementation to run (default: all of them)
+//            -n  number of items to move through the buffer (default 10000000)
+//            -s  number of buffer slots (default BUFFER_SIZE)
+//            -z  size of one item in bytes, a multiple of 8 (default 8)
+//            -P  number of producer threads (default 1)
+//            -C  number of consumer threads (default 1)
+//            -a  pin every thread to its own core (round robin over the online CPUs)
+//            -S  scaling sweep from 1x1 up to 32x32 threads
+//            -b  move items in batches of up to this many (lock-free queues only)
+//            -A  adapt the batch size between 1 and -b to the load
+//            -w  how a lock-free queue waits when it is full or empty (default adaptive)
+//            -L  wake-up latency test: the producer sends one item per interval, and every
+//                wait strategy reports latency percentiles and CPU cost
+//            -T  benchmark harness: after a warm-up run, time this many trials, stamp every item
+//                on enqueue and dequeue, and report throughput and latency up to p99.99
+//            -W  items in the untimed warm-up run of the harness (default items / 10)
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+#include <math.h>
+#include <linux/futex.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#define BUFFER_SIZE 5
+#define CACHE_LINE 64
+#define SPIN_LIMIT 128 // Failed attempts before a waiting side yields the CPU
+#define YIELD_LIMIT 16 // Yields before an adaptive waiter parks in the kernel
+
+#define WAIT_SPIN 0     // Spin with pause until the queue changes
+#define WAIT_ADAPTIVE 1 // Spin briefly, then yield, then park on a futex
+#define WAIT_BLOCK 2    // Park on a futex straight away
+
+#define HIST_SUB_BITS 5 // 32 sub-buckets per power of two, about 3% error
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS (60 * HIST_SUB_BUCKETS)
+
+#define MAX_THREADS 64 // Per side
+#define MAX_BATCH 4096
+#define MAX_ITEM_SIZE 4096
+
+// The leading word of every item; the rest of an item (see -z) is payload that is only copied
+typedef unsigned long Item;
+
+// A bounded buffer of fixed-size items: create it, then push/pop block until they succeed.
+// Batches are itemSize-strided arrays of items.
+struct QueueOps {
+    const char *name;
+    int multi; // Safe with more than one producer or consumer
+    int spins; // Waits with the -w strategy; otherwise it always blocks in the kernel
+    void *(*create)(int slots, size_t itemSize);
+    void (*destroy)(void *queue);
+    void (*push)(void *queue, const void *item);
+    void (*pop)(void *queue, void *item);
+    // Optional: move several items with one publication; NULL falls back to push/pop
+    // pushBatch blocks until all are in and returns how many items were queued right after;
+    // popBatch blocks until it has at least one
+    int (*pushBatch)(void *queue, const void *items, int count);
+    int (*popBatch)(void *queue, void *items, int max);
+};
+
+// The bounded buffer from 7.c: counting semaphores plus one mutex around buffer[], in and out
+struct SemQueue {
+    unsigned char *buffer;
+    size_t itemSize;
+    int size;
+    int in;  // Points to the next empty slot
+    int out; // Points to the next full slot
+    sem_t empty;
+    sem_t full;
+    pthread_mutex_t mutex;
+};
+
+// Event count for parking threads on a futex. A waiter registers, re-checks the queue and then
+// sleeps on seq; a notifier publishes, then only enters the kernel when someone is registered.
+struct WaitPoint {
+    _Alignas(CACHE_LINE) atomic_uint seq; // Futex word, bumped by every wake-up
+    atomic_uint waiters;
+};
+
+// Lock-free single-producer/single-consumer ring. Each side owns one index on its own cache line
+// and keeps a cached copy of the other side's index, so it only touches the other side's line
+// when the ring looks full (producer) or empty (consumer). One slot is left unused so a full
+// ring can be told apart from an empty one without a shared counter.
+struct SpscRing {
+    _Alignas(CACHE_LINE) atomic_uint head; // Next slot to read, written by the consumer
+    unsigned cachedTail;                   // Consumer's last view of tail
+
+    _Alignas(CACHE_LINE) atomic_uint tail; // Next slot to write, written by the producer
+    unsigned cachedHead;                   // Producer's last view of head
+
+    _Alignas(CACHE_LINE) unsigned char *slots;
+    size_t itemSize;
+    unsigned capacity; // slots + 1
+
+    struct WaitPoint notEmpty; // Consumer parks here
+    struct WaitPoint notFull;  // Producer parks here
+};
+
+// Vyukov bounded MPMC queue: every cell carries a sequence number that says whose turn it is.
+// Producers and consumers claim positions with a CAS on their own counter and then only touch
+// the claimed cell, so there is no shared lock and the two counters sit on separate lines.
+struct MpmcCell {
+    atomic_size_t sequence;
+    unsigned char data[]; // itemSize bytes
+};
+
+struct MpmcQueue {
+    _Alignas(CACHE_LINE) atomic_size_t enqueuePos;
+    _Alignas(CACHE_LINE) atomic_size_t dequeuePos;
+    _Alignas(CACHE_LINE) unsigned char *cells;
+    size_t cellSize; // Sequence number plus one item
+    size_t itemSize;
+    size_t mask; // Capacity - 1, the capacity is a power of two
+
+    struct WaitPoint notEmpty;
+    struct WaitPoint notFull;
+};
+
+// Log-linear latency histogram (HDR style): exact below 64, then 32 buckets per power of two
+struct Histogram {
+    long long count;
+    long long max;
+    long long buckets[HIST_BUCKETS];
+};
+
+struct RunArgs {
+    const struct QueueOps *ops;
+    void *queue;
+    long items;
+    int cpu;       // Core to pin to, or -1
+    Item checksum; // Sum of every item produced or consumed by this thread
+    long intervalNs;         // Latency test: gap between items sent by the producer
+    struct Histogram *hist;  // Consumer: enqueue-to-dequeue latency (latency test and harness)
+    double cpuSeconds;       // User plus system CPU time used by this thread
+};
+
+int spinLimit = SPIN_LIMIT; // Zero on a single CPU, where spinning only delays the other side
+int batchSize = 0;          // Largest batch, 0 moves items one at a time
+int adaptiveBatch = 0;      // Grow and shrink the batch with the load
+int waitStrategy = WAIT_ADAPTIVE;
+int stampItems = 0;         // Harness: producers send their enqueue time as the item value
+size_t itemSize = sizeof(Item);
+const char *waitNames[] = {"spin", "adaptive", "block"};
+
+double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+long long nowNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+double threadCpuSeconds() {
+    struct rusage ru;
+    getrusage(RUSAGE_THREAD, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+void histRecord(struct Histogram *h, long long value) {
+    int index;
+
+    if (value < 2 * HIST_SUB_BUCKETS) {
+        index = value < 0 ? 0 : (int)value;
+    } else {
+        int shift = 63 - __builtin_clzll(value) - HIST_SUB_BITS;
+        index = (shift + 1) * HIST_SUB_BUCKETS + (int)(value >> shift) - HIST_SUB_BUCKETS;
+    }
+    h->buckets[index]++;
+    h->count++;
+    if (value > h->max) {
+        h->max = value;
+    }
+}
+
+// Upper bound of the bucket holding quantile q (0..1), capped at the largest value seen
+long long histQuantile(const struct Histogram *h, double q) {
+    long long rank = (long long)(q * h->count + 0.5);
+    long long seen = 0;
+
+    if (rank < 1) {
+        rank = 1;
+    }
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            if (i < 2 * HIST_SUB_BUCKETS) {
+                return i;
+            }
+            int shift = i / HIST_SUB_BUCKETS - 1;
+            long long upper = ((long long)(i % HIST_SUB_BUCKETS + HIST_SUB_BUCKETS + 1) << shift) - 1;
+            return upper < h->max ? upper : h->max;
+        }
+    }
+    return h->max;
+}
+
+// Add every bucket of src to dst
+void histMerge(struct Histogram *dst, const struct Histogram *src) {
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+    dst->count += src->count;
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+}
+
+static inline void setItem(void *item, Item value) {
+    memcpy(item, &value, sizeof(Item));
+}
+
+static inline Item getItem(const void *item) {
+    Item value;
+
+    memcpy(&value, item, sizeof(Item));
+    return value;
+}
+
+// Plain items are one word, so the common case compiles to a single load and store
+static inline void copyItem(void *dst, const void *src, size_t size) {
+    if (size == sizeof(Item)) {
+        memcpy(dst, src, sizeof(Item));
+    } else {
+        memcpy(dst, src, size);
+    }
+}
+
+static inline void futexWait(atomic_uint *addr, unsigned expected) {
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+static inline void futexWake(atomic_uint *addr, int count) {
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// Wait for a cell another thread has claimed but not yet published. Nothing wakes a thread
+// parked on that, so this spins like the adaptive strategy and then keeps yielding: if the
+// publisher was preempted, it gets the CPU back instead of the waiter burning its timeslice.
+static inline void awaitCell(int *spins) {
+    if (++*spins < spinLimit) {
+        cpuRelax();
+    } else {
+        sched_yield();
+    }
+}
+
+// Called after a failed attempt; returns once it is worth trying again. Depending on the
+// strategy it spins with pause, yields, or parks until ready(queue) may have become true.
+static inline void awaitReady(struct WaitPoint *wp, int *spins, int (*ready)(void *), void *queue) {
+    if (waitStrategy == WAIT_SPIN) {
+        cpuRelax();
+        return;
+    }
+    if (waitStrategy == WAIT_ADAPTIVE && *spins < spinLimit + YIELD_LIMIT) {
+        if (++*spins < spinLimit) {
+            cpuRelax();
+        } else {
+            sched_yield();
+        }
+        return;
+    }
+
+    unsigned key = atomic_load_explicit(&wp->seq, memory_order_acquire);
+    atomic_fetch_add(&wp->waiters, 1); // Sequentially consistent, pairs with the fence in wakeWaiters
+    if (!ready(queue)) {
+        futexWait(&wp->seq, key); // Returns at once if a wake-up bumped seq after key was read
+    }
+    atomic_fetch_sub(&wp->waiters, 1);
+    *spins = 0;
+}
+
+// After publishing count items (or freeing count slots), wake up to count parked threads
+static inline void wakeWaiters(struct WaitPoint *wp, int count) {
+    if (waitStrategy == WAIT_SPIN) {
+        return;
+    }
+    atomic_thread_fence(memory_order_seq_cst); // Either we see the waiter or it sees our publish
+    if (atomic_load_explicit(&wp->waiters, memory_order_relaxed) > 0) {
+        atomic_fetch_add_explicit(&wp->seq, 1, memory_order_release);
+        futexWake(&wp->seq, count);
+    }
+}
+
+void *semCreate(int slots, size_t itemSize) {
+    struct SemQueue *q = calloc(1, sizeof(struct SemQueue));
+
+    q->buffer = malloc(slots * itemSize);
+    q->itemSize = itemSize;
+    q->size = slots;
+    sem_init(&q->empty, 0, slots); // All slots empty initially
+    sem_init(&q->full, 0, 0);      // No full slots initially
+    pthread_mutex_init(&q->mutex, NULL);
+    return q;
+}
+
+void semDestroy(void *queue) {
+    struct SemQueue *q = queue;
+
+    sem_destroy(&q->empty);
+    sem_destroy(&q->full);
+    pthread_mutex_destroy(&q->mutex);
+    free(q->buffer);
+    free(q);
+}
+
+void semPush(void *queue, const void *item) {
+    struct SemQueue *q = queue;
+
+    sem_wait(&q->empty);           // Wait for an empty slot
+    pthread_mutex_lock(&q->mutex); // Enter critical section
+    copyItem(q->buffer + q->in * q->itemSize, item, q->itemSize);
+    q->in = (q->in + 1) % q->size;
+    pthread_mutex_unlock(&q->mutex); // Exit critical section
+    sem_post(&q->full);              // Increment the number of full slots
+}
+
+void semPop(void *queue, void *item) {
+    struct SemQueue *q = queue;
+
+    sem_wait(&q->full); // Wait for a full slot
+    pthread_mutex_lock(&q->mutex);
+    copyItem(item, q->buffer + q->out * q->itemSize, q->itemSize);
+    q->out = (q->out + 1) % q->size;
+    pthread_mutex_unlock(&q->mutex);
+    sem_post(&q->empty); // Increment the number of empty slots
+}
+
+void *spscCreate(int slots, size_t itemSize) {
+    struct SpscRing *q = aligned_alloc(CACHE_LINE, sizeof(struct SpscRing));
+
+    memset(q, 0, sizeof(*q));
+    q->capacity = slots + 1;
+    q->itemSize = itemSize;
+    q->slots = malloc(q->capacity * itemSize);
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    return q;
+}
+
+void spscDestroy(void *queue) {
+    struct SpscRing *q = queue;
+
+    free(q->slots);
+    free(q);
+}
+
+// Producer side: returns 0 when the ring is full
+static inline int spscTryPush(struct SpscRing *q, const void *item) {
+    unsigned tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    unsigned next = tail + 1 == q->capacity ? 0 : tail + 1;
+
+    if (next == q->cachedHead) {
+        q->cachedHead = atomic_load_explicit(&q->head, memory_order_acquire);
+        if (next == q->cachedHead) {
+            return 0;
+        }
+    }
+    copyItem(q->slots + tail * q->itemSize, item, q->itemSize);
+    // Release publishes the slot contents before the new tail
+    atomic_store_explicit(&q->tail, next, memory_order_release);
+    return 1;
+}
+
+// Consumer side: returns 0 when the ring is empty
+static inline int spscTryPop(struct SpscRing *q, void *item) {
+    unsigned head = atomic_load_explicit(&q->head, memory_order_relaxed);
+
+    if (head == q->cachedTail) {
+        q->cachedTail = atomic_load_explicit(&q->tail, memory_order_acquire);
+        if (head == q->cachedTail) {
+            return 0;
+        }
+    }
+    copyItem(item, q->slots + head * q->itemSize, q->itemSize);
+    // Release hands the slot back to the producer only after it has been read
+    atomic_store_explicit(&q->head, head + 1 == q->capacity ? 0 : head + 1, memory_order_release);
+    return 1;
+}
+
+// Reserve up to count free slots, fill them and publish them all with one tail store
+static inline int spscTryPushBatch(struct SpscRing *q, const unsigned char *items, int count) {
+    unsigned tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    unsigned capacity = q->capacity;
+    unsigned space = (q->cachedHead + capacity - tail - 1) % capacity;
+
+    if (space < (unsigned)count) {
+        q->cachedHead = atomic_load_explicit(&q->head, memory_order_acquire);
+        space = (q->cachedHead + capacity - tail - 1) % capacity;
+    }
+    if ((unsigned)count > space) {
+        count = space;
+    }
+    for (int i = 0; i < count; i++) {
+        copyItem(q->slots + tail * q->itemSize, items + i * q->itemSize, q->itemSize);
+        tail = tail + 1 == capacity ? 0 : tail + 1;
+    }
+    if (count > 0) {
+        atomic_store_explicit(&q->tail, tail, memory_order_release);
+    }
+    return count;
+}
+
+// Drain up to max filled slots and hand them all back with one head store
+static inline int spscTryPopBatch(struct SpscRing *q, unsigned char *items, int max) {
+    unsigned head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    unsigned capacity = q->capacity;
+    unsigned ready = (q->cachedTail + capacity - head) % capacity;
+
+    if (ready < (unsigned)max) {
+        q->cachedTail = atomic_load_explicit(&q->tail, memory_order_acquire);
+        ready = (q->cachedTail + capacity - head) % capacity;
+    }
+    if ((unsigned)max > ready) {
+        max = ready;
+    }
+    for (int i = 0; i < max; i++) {
+        copyItem(items + i * q->itemSize, q->slots + head * q->itemSize, q->itemSize);
+        head = head + 1 == capacity ? 0 : head + 1;
+    }
+    if (max > 0) {
+        atomic_store_explicit(&q->head, head, memory_order_release);
+    }
+    return max;
+}
+
+int spscCanPush(void *queue) {
+    struct SpscRing *q = queue;
+    unsigned tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+    return (tail + 1 == q->capacity ? 0 : tail + 1) != atomic_load_explicit(&q->head, memory_order_acquire);
+}
+
+int spscCanPop(void *queue) {
+    struct SpscRing *q = queue;
+
+    return atomic_load_explicit(&q->head, memory_order_relaxed) !=
+           atomic_load_explicit(&q->tail, memory_order_acquire);
+}
+
+void spscPush(void *queue, const void *item) {
+    struct SpscRing *q = queue;
+    int spins = 0;
+
+    while (!spscTryPush(q, item)) {
+        awaitReady(&q->notFull, &spins, spscCanPush, q);
+    }
+    wakeWaiters(&q->notEmpty, 1);
+}
+
+void spscPop(void *queue, void *item) {
+    struct SpscRing *q = queue;
+    int spins = 0;
+
+    while (!spscTryPop(q, item)) {
+        awaitReady(&q->notEmpty, &spins, spscCanPop, q);
+    }
+    wakeWaiters(&q->notFull, 1);
+}
+
+static inline struct MpmcCell *mpmcCell(struct MpmcQueue *q, size_t pos) {
+    return (struct MpmcCell *)(q->cells + (pos & q->mask) * q->cellSize);
+}
+
+// The capacity is rounded up to a power of two so positions map to cells with a mask
+void *mpmcCreate(int slots, size_t itemSize) {
+    struct MpmcQueue *q = aligned_alloc(CACHE_LINE, sizeof(struct MpmcQueue));
+    size_t capacity = 1;
+
+    while (capacity < (size_t)slots) {
+        capacity <<= 1;
+    }
+    memset(q, 0, sizeof(*q));
+    q->itemSize = itemSize;
+    q->cellSize = sizeof(struct MpmcCell) + itemSize; // itemSize is a multiple of the word size
+    q->cells = malloc(capacity * q->cellSize);
+    q->mask = capacity - 1;
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(&mpmcCell(q, i)->sequence, i);
+    }
+    atomic_init(&q->enqueuePos, 0);
+    atomic_init(&q->dequeuePos, 0);
+    return q;
+}
+
+void mpmcDestroy(void *queue) {
+    struct MpmcQueue *q = queue;
+
+    free(q->cells);
+    free(q);
+}
+
+// A cell is free for position pos when its sequence equals pos
+static inline int mpmcTryPush(struct MpmcQueue *q, const void *item) {
+    size_t pos = atomic_load_explicit(&q->enqueuePos, memory_order_relaxed);
+
+    for (;;) {
+        struct MpmcCell *cell = mpmcCell(q, pos);
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        long diff = (long)(seq - pos);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->enqueuePos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                copyItem(cell->data, item, q->itemSize);
+                atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+                return 1;
+            }
+            // pos was reloaded by the failed CAS
+        } else if (diff < 0) {
+            return 0; // The cell still holds an item from one lap ago: full
+        } else {
+            pos = atomic_load_explicit(&q->enqueuePos, memory_order_relaxed);
+        }
+    }
+}
+
+// A cell holds the item for position pos when its sequence equals pos + 1
+static inline int mpmcTryPop(struct MpmcQueue *q, void *item) {
+    size_t pos = atomic_load_explicit(&q->dequeuePos, memory_order_relaxed);
+
+    for (;;) {
+        struct MpmcCell *cell = mpmcCell(q, pos);
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        long diff = (long)(seq - (pos + 1));
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->dequeuePos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                copyItem(item, cell->data, q->itemSize);
+                // Free the cell for the producer one lap ahead
+                atomic_store_explicit(&cell->sequence, pos + q->mask + 1, memory_order_release);
+                return 1;
+            }
+        } else if (diff < 0) {
+            return 0; // Not yet written: empty
+        } else {
+            pos = atomic_load_explicit(&q->dequeuePos, memory_order_relaxed);
+        }
+    }
+}
+
+int mpmcCanPush(void *queue) {
+    struct MpmcQueue *q = queue;
+    size_t pos = atomic_load_explicit(&q->enqueuePos, memory_order_relaxed);
+
+    return (long)(atomic_load_explicit(&mpmcCell(q, pos)->sequence, memory_order_acquire) - pos) >= 0;
+}
+
+int mpmcCanPop(void *queue) {
+    struct MpmcQueue *q = queue;
+    size_t pos = atomic_load_explicit(&q->dequeuePos, memory_order_relaxed);
+
+    return (long)(atomic_load_explicit(&mpmcCell(q, pos)->sequence, memory_order_acquire) - (pos + 1)) >= 0;
+}
+
+void mpmcPush(void *queue, const void *item) {
+    struct MpmcQueue *q = queue;
+    int spins = 0;
+
+    while (!mpmcTryPush(q, item)) {
+        awaitReady(&q->notFull, &spins, mpmcCanPush, q);
+    }
+    wakeWaiters(&q->notEmpty, 1);
+}
+
+void mpmcPop(void *queue, void *item) {
+    struct MpmcQueue *q = queue;
+    int spins = 0;
+
+    while (!mpmcTryPop(q, item)) {
+        awaitReady(&q->notEmpty, &spins, mpmcCanPop, q);
+    }
+    wakeWaiters(&q->notFull, 1);
+}
+
+// One wake-up per published batch rather than one per item
+int spscPushBatch(void *queue, const void *items, int count) {
+    struct SpscRing *q = queue;
+    const unsigned char *next = items;
+    int spins = 0;
+
+    while (count > 0) {
+        int pushed = spscTryPushBatch(q, next, count);
+        if (pushed == 0) {
+            awaitReady(&q->notFull, &spins, spscCanPush, q);
+            continue;
+        }
+        wakeWaiters(&q->notEmpty, pushed);
+        next += pushed * q->itemSize;
+        count -= pushed;
+    }
+    unsigned tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    return (tail + q->capacity - atomic_load_explicit(&q->head, memory_order_acquire)) % q->capacity;
+}
+
+int spscPopBatch(void *queue, void *items, int max) {
+    struct SpscRing *q = queue;
+    int spins = 0;
+    int popped;
+
+    while ((popped = spscTryPopBatch(q, items, max)) == 0) {
+        awaitReady(&q->notEmpty, &spins, spscCanPop, q);
+    }
+    wakeWaiters(&q->notFull, popped);
+    return popped;
+}
+
+// Claim up to count positions with one CAS. Only positions whose last cell is already free are
+// claimed; the earlier cells were handed to consumers before it, so any wait for them is short.
+static inline int mpmcTryPushBatch(struct MpmcQueue *q, const unsigned char *items, int count) {
+    size_t pos = atomic_load_explicit(&q->enqueuePos, memory_order_relaxed);
+
+    if ((size_t)count > q->mask + 1) {
+        count = q->mask + 1;
+    }
+    while (count > 0) {
+        struct MpmcCell *last = mpmcCell(q, pos + count - 1);
+        long diff = (long)(atomic_load_explicit(&last->sequence, memory_order_acquire) - (pos + count - 1));
+
+        if (diff < 0) {
+            count /= 2; // Not that much room: try a smaller batch
+            continue;
+        }
+        if (diff > 0) {
+            pos = atomic_load_explicit(&q->enqueuePos, memory_order_relaxed);
+            continue;
+        }
+        if (atomic_compare_exchange_weak_explicit(&q->enqueuePos, &pos, pos + count,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        struct MpmcCell *cell = mpmcCell(q, pos + i);
+        int spins = 0;
+        while (atomic_load_explicit(&cell->sequence, memory_order_acquire) != pos + i) {
+            awaitCell(&spins);
+        }
+        copyItem(cell->data, items + i * q->itemSize, q->itemSize);
+        atomic_store_explicit(&cell->sequence, pos + i + 1, memory_order_release);
+    }
+    return count;
+}
+
+// Claim up to max filled positions with one CAS, by the same argument as the push side
+static inline int mpmcTryPopBatch(struct MpmcQueue *q, unsigned char *items, int max) {
+    size_t pos = atomic_load_explicit(&q->dequeuePos, memory_order_relaxed);
+
+    if ((size_t)max > q->mask + 1) {
+        max = q->mask + 1;
+    }
+    while (max > 0) {
+        struct MpmcCell *last = mpmcCell(q, pos + max - 1);
+        long diff = (long)(atomic_load_explicit(&last->sequence, memory_order_acquire) - (pos + max));
+
+        if (diff < 0) {
+            max /= 2;
+            continue;
+        }
+        if (diff > 0) {
+            pos = atomic_load_explicit(&q->dequeuePos, memory_order_relaxed);
+            continue;
+        }
+        if (atomic_compare_exchange_weak_explicit(&q->dequeuePos, &pos, pos + max,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    for (int i = 0; i < max; i++) {
+        struct MpmcCell *cell = mpmcCell(q, pos + i);
+        int spins = 0;
+        while (atomic_load_explicit(&cell->sequence, memory_order_acquire) != pos + i + 1) {
+            awaitCell(&spins);
+        }
+        copyItem(items + i * q->itemSize, cell->data, q->itemSize);
+        atomic_store_explicit(&cell->sequence, pos + i + q->mask + 1, memory_order_release);
+    }
+    return max;
+}
+
+int mpmcPushBatch(void *queue, const void *items, int count) {
+    struct MpmcQueue *q = queue;
+    const unsigned char *next = items;
+    int spins = 0;
+
+    while (count > 0) {
+        int pushed = mpmcTryPushBatch(q, next, count);
+        if (pushed == 0) {
+            awaitReady(&q->notFull, &spins, mpmcCanPush, q);
+            continue;
+        }
+        wakeWaiters(&q->notEmpty, pushed);
+        next += pushed * q->itemSize;
+        count -= pushed;
+    }
+    // Both positions move while they are read, so this is only an estimate
+    long queued = (long)(atomic_load_explicit(&q->enqueuePos, memory_order_relaxed) -
+                         atomic_load_explicit(&q->dequeuePos, memory_order_relaxed));
+    return queued < 0 ? 0 : queued > (long)q->mask + 1 ? (int)q->mask + 1 : (int)queued;
+}
+
+int mpmcPopBatch(void *queue, void *items, int max) {
+    struct MpmcQueue *q = queue;
+    int spins = 0;
+    int popped;
+
+    while ((popped = mpmcTryPopBatch(q, items, max)) == 0) {
+        awaitReady(&q->notEmpty, &spins, mpmcCanPop, q);
+    }
+    wakeWaiters(&q->notFull, popped);
+    return popped;
+}
+
+const struct QueueOps queues[] = {
+    {"sem", 1, 0, semCreate, semDestroy, semPush, semPop, NULL, NULL},
+    {"spsc", 0, 1, spscCreate, spscDestroy, spscPush, spscPop, spscPushBatch, spscPopBatch},
+    {"mpmc", 1, 1, mpmcCreate, mpmcDestroy, mpmcPush, mpmcPop, mpmcPushBatch, mpmcPopBatch},
+};
+const int queueCount = sizeof(queues) / sizeof(queues[0]);
+
+void pinThread(int cpu) {
+    cpu_set_t set;
+
+    if (cpu < 0) {
+        return;
+    }
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+static inline void resizeBatch(int *batch, bool grow, bool shrink) {
+    if (!adaptiveBatch) {
+        return;
+    }
+    if (grow && *batch < batchSize) {
+        *batch *= 2;
+        if (*batch > batchSize) {
+            *batch = batchSize;
+        }
+    } else if (shrink && *batch > 1) {
+        *batch /= 2;
+    }
+}
+
+// Consumer: double the batch while full batches keep moving, halve it once a batch comes back
+// less than half full. A consumer that drains little has caught up with its producers, so small
+// batches keep latency low; under load the batch grows and the synchronization cost is amortized.
+static inline void adaptBatch(int *batch, int moved) {
+    resizeBatch(batch, moved == *batch, moved < *batch / 2);
+}
+
+// Producer: a full batch always goes in, so the signal is how many items were queued right after
+// it. At least two batches' worth means the consumers are behind and bigger batches pay off; less
+// than half a batch means they drained most of it at once and the queue is nearly empty.
+static inline void adaptPushBatch(int *batch, int queued) {
+    resizeBatch(batch, queued >= 2 * *batch, queued < *batch / 2);
+}
+
+// The value of the i-th item: its sequence number, or in the harness the time it is enqueued
+static inline Item nextItem(long i) {
+    return stampItems ? (Item)nowNanos() : (Item)i;
+}
+
+void *producer(void *arg) {
+    struct RunArgs *args = arg;
+
+    pinThread(args->cpu);
+    if (batchSize > 0 && args->ops->pushBatch) {
+        unsigned char *items = calloc(batchSize, itemSize);
+        int batch = adaptiveBatch ? 1 : batchSize;
+        long i = 1;
+
+        while (i <= args->items) {
+            int count = 0;
+            while (count < batch && i <= args->items) {
+                Item value = nextItem(i++); // Produce an item
+                setItem(items + count++ * itemSize, value);
+                args->checksum += value;
+            }
+            int queued = args->ops->pushBatch(args->queue, items, count);
+            adaptPushBatch(&batch, queued);
+        }
+        free(items);
+        args->cpuSeconds = threadCpuSeconds();
+        return NULL;
+    }
+
+    unsigned char *item = calloc(1, itemSize);
+    for (long i = 1; i <= args->items; i++) {
+        Item value = nextItem(i); // Produce an item
+        setItem(item, value);
+        args->ops->push(args->queue, item);
+        args->checksum += value;
+    }
+    free(item);
+    args->cpuSeconds = threadCpuSeconds();
+    return NULL;
+}
+
+// With a histogram the consumer stamps every dequeue and records how long the item was queued
+void *consumer(void *arg) {
+    struct RunArgs *args = arg;
+
+    pinThread(args->cpu);
+    if (batchSize > 0 && args->ops->popBatch) {
+        unsigned char *items = calloc(batchSize, itemSize);
+        int batch = adaptiveBatch ? 1 : batchSize;
+        long left = args->items;
+
+        while (left > 0) {
+            // Never take more than this consumer's share, or another consumer would starve
+            int want = left < batch ? (int)left : batch;
+            int got = args->ops->popBatch(args->queue, items, want);
+            long long now = args->hist ? nowNanos() : 0; // Every item of a batch leaves together
+            for (int i = 0; i < got; i++) {
+                Item value = getItem(items + i * itemSize); // Consume an item
+                args->checksum += value;
+                if (args->hist) {
+                    histRecord(args->hist, now - (long long)value);
+                }
+            }
+            left -= got;
+            adaptBatch(&batch, got);
+        }
+        free(items);
+        args->cpuSeconds = threadCpuSeconds();
+        return NULL;
+    }
+
+    unsigned char *item = calloc(1, itemSize);
+    for (long i = 0; i < args->items; i++) {
+        args->ops->pop(args->queue, item); // Consume an item
+        Item value = getItem(item);
+        args->checksum += value;
+        if (args->hist) {
+            histRecord(args->hist, nowNanos() - (long long)value);
+        }
+    }
+    free(item);
+    args->cpuSeconds = threadCpuSeconds();
+    return NULL;
+}
+
+// Latency test producer: one item per interval, each item carrying its publish time
+void *latencyProducer(void *arg) {
+    struct RunArgs *args = arg;
+    struct timespec next;
+
+    unsigned char *item = calloc(1, itemSize);
+
+    pinThread(args->cpu);
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (long i = 0; i < args->items; i++) {
+        next.tv_nsec += args->intervalNs;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+        Item stamp = (Item)nowNanos();
+        setItem(item, stamp);
+        args->ops->push(args->queue, item);
+        args->checksum += stamp;
+    }
+    free(item);
+    args->cpuSeconds = threadCpuSeconds();
+    return NULL;
+}
+
+// Latency test consumer: mostly waiting on an empty queue, so this measures the wake-up path
+void *latencyConsumer(void *arg) {
+    struct RunArgs *args = arg;
+    unsigned char *item = calloc(1, itemSize);
+
+    pinThread(args->cpu);
+    for (long i = 0; i < args->items; i++) {
+        args->ops->pop(args->queue, item);
+        Item stamp = getItem(item);
+        histRecord(args->hist, nowNanos() - (long long)stamp);
+        args->checksum += stamp;
+    }
+    free(item);
+    args->cpuSeconds = threadCpuSeconds();
+    return NULL;
+}
+
+// Wake-up latency and CPU cost of every wait strategy for one producer and one consumer
+void latencyTest(const struct QueueOps *ops, long items, int slots, long intervalUs, int pin) {
+    int cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    printf("%s queue, %ld items, one every %ld us\n\n", ops->name, items, intervalUs);
+    printf("Wait\t\tp50 us\tp90 us\tp99 us\tp99.9 us\tmax us\tConsumer CPU\tProducer CPU\n");
+    // The semaphore queue always sleeps in sem_wait, so it only has the one row
+    for (int strategy = ops->spins ? WAIT_SPIN : WAIT_BLOCK; strategy <= WAIT_BLOCK; strategy++) {
+        struct Histogram *hist = calloc(1, sizeof(struct Histogram));
+        struct RunArgs prodArgs = {ops, ops->create(slots, itemSize), items, pin ? 0 : -1, 0, intervalUs * 1000, NULL, 0};
+        struct RunArgs consArgs = {ops, prodArgs.queue, items, pin ? 1 % cpus : -1, 0, 0, hist, 0};
+        pthread_t prod, cons;
+
+        waitStrategy = strategy;
+        double start = nowSeconds();
+        pthread_create(&cons, NULL, latencyConsumer, &consArgs);
+        pthread_create(&prod, NULL, latencyProducer, &prodArgs);
+        pthread_join(prod, NULL);
+        pthread_join(cons, NULL);
+        double elapsed = nowSeconds() - start;
+
+        if (prodArgs.checksum != consArgs.checksum) {
+            fprintf(stderr, "%s: checksum mismatch, items were lost or duplicated\n", ops->name);
+        }
+        printf("%-8s\t%.1f\t%.1f\t%.1f\t%.1f\t\t%.1f\t%.1f%%\t\t%.1f%%\n", waitNames[strategy],
+               histQuantile(hist, 0.5) / 1e3, histQuantile(hist, 0.9) / 1e3, histQuantile(hist, 0.99) / 1e3,
+               histQuantile(hist, 0.999) / 1e3, hist->max / 1e3, consArgs.cpuSeconds / elapsed * 100,
+               prodArgs.cpuSeconds / elapsed * 100);
+
+        ops->destroy(prodArgs.queue);
+        free(hist);
+    }
+}
+
+// Move items through the queue with the given numbers of producer and consumer threads, each
+// side splitting the items evenly; returns seconds taken. With a histogram every item carries
+// its enqueue time and the enqueue-to-dequeue latency of every item is added to it.
+double runQueue(const struct QueueOps *ops, long items, int slots, int producers, int consumers, int pin,
+                struct Histogram *hist) {
+    pthread_t prod[MAX_THREADS], cons[MAX_THREADS];
+    struct RunArgs prodArgs[MAX_THREADS], consArgs[MAX_THREADS];
+    void *queue = ops->create(slots, itemSize);
+    int cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    Item produced = 0, consumed = 0;
+
+    for (int i = 0; i < producers; i++) {
+        struct RunArgs args = {ops, queue, items / producers + (i < items % producers), pin ? i % cpus : -1, 0, 0, NULL, 0};
+        prodArgs[i] = args;
+    }
+    for (int i = 0; i < consumers; i++) {
+        struct RunArgs args = {ops, queue, items / consumers + (i < items % consumers),
+                               pin ? (producers + i) % cpus : -1, 0, 0, NULL, 0};
+        consArgs[i] = args;
+        if (hist) {
+            consArgs[i].hist = calloc(1, sizeof(struct Histogram)); // One each, merged after the run
+        }
+    }
+    stampItems = hist != NULL;
+
+    double start = nowSeconds();
+    for (int i = 0; i < producers; i++) {
+        pthread_create(&prod[i], NULL, producer, &prodArgs[i]);
+    }
+    for (int i = 0; i < consumers; i++) {
+        pthread_create(&cons[i], NULL, consumer, &consArgs[i]);
+    }
+    for (int i = 0; i < producers; i++) {
+        pthread_join(prod[i], NULL);
+        produced += prodArgs[i].checksum;
+    }
+    for (int i = 0; i < consumers; i++) {
+        pthread_join(cons[i], NULL);
+        consumed += consArgs[i].checksum;
+    }
+    double elapsed = nowSeconds() - start;
+
+    for (int i = 0; i < consumers && hist; i++) {
+        histMerge(hist, consArgs[i].hist);
+        free(consArgs[i].hist);
+    }
+
+    if (produced != consumed) {
+        fprintf(stderr, "%s: checksum mismatch, items were lost or duplicated\n", ops->name);
+    }
+    ops->destroy(queue);
+    return elapsed;
+}
+
+// Benchmark harness: one untimed warm-up run to fault in memory and settle the CPU clocks, then
+// trials timed runs on a fresh queue each. Throughput is summarized over the trials and the
+// latency percentiles come from every item of every trial.
+void benchmarkHarness(const struct QueueOps *ops, long items, int slots, int producers, int consumers, int pin,
+                      long warmup, int trials) {
+    struct Histogram *hist = calloc(1, sizeof(struct Histogram));
+    double mean = 0, m2 = 0, best = 0, worst = 0; // Welford, as in 18.c: no cancellation at 10^8/s
+
+    if (warmup > 0) {
+        runQueue(ops, warmup, slots, producers, consumers, pin, NULL);
+    }
+    for (int t = 0; t < trials; t++) {
+        double rate = items / runQueue(ops, items, slots, producers, consumers, pin, hist);
+
+        double delta = rate - mean;
+        mean += delta / (t + 1);
+        m2 += delta * (rate - mean);
+        if (t == 0 || rate > best) {
+            best = rate;
+        }
+        if (t == 0 || rate < worst) {
+            worst = rate;
+        }
+    }
+
+    double stddev = trials > 1 ? sqrt(m2 / (trials - 1)) : 0;
+    printf("%s\t%dx%d\t%.0f\t%.0f\t%.0f\t%.0f\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\n", ops->name, producers,
+           consumers, mean, stddev, worst, best, histQuantile(hist, 0.5) / 1e3,
+           histQuantile(hist, 0.9) / 1e3, histQuantile(hist, 0.99) / 1e3, histQuantile(hist, 0.999) / 1e3,
+           histQuantile(hist, 0.9999) / 1e3, hist->max / 1e3);
+    free(hist);
+}
+
+// Throughput of every multi-threaded queue from 1x1 to 32x32 producers x consumers
+void scalingSweep(long items, int slots, int pin) {
+    printf("Threads\t");
+    for (int i = 0; i < queueCount; i++) {
+        if (queues[i].multi) {
+            printf("\t%s items/sec", queues[i].name);
+        }
+    }
+    printf("\n");
+
+    for (int threads = 1; threads <= 32; threads *= 2) {
+        printf("%dx%d\t", threads, threads);
+        for (int i = 0; i < queueCount; i++) {
+            if (queues[i].multi) {
+                double elapsed = runQueue(&queues[i], items, slots, threads, threads, pin, NULL);
+                printf("\t%.0f", items / elapsed);
+            }
+        }
+        printf("\n");
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *mode = NULL;
+    long items = 10000000;
+    int slots = BUFFER_SIZE;
+    int producers = 1, consumers = 1;
+    int pin = 0, scaling = 0;
+    int itemsSet = 0;
+    long latencyInterval = 0;
+    int trials = 0;
+    long warmup = -1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:n:s:z:P:C:aSb:Aw:L:T:W:")) != -1) {
+        switch (opt) {
+        case 'm':
+            mode = optarg;
+            break;
+        case 'n':
+            items = atol(optarg);
+            itemsSet = 1;
+            break;
+        case 's':
+            slots = atoi(optarg);
+            break;
+        case 'z':
+            itemSize = (size_t)atol(optarg);
+            break;
+        case 'P':
+            producers = atoi(optarg);
+            break;
+        case 'C':
+            consumers = atoi(optarg);
+            break;
+        case 'a':
+            pin = 1;
+            break;
+        case 'S':
+            scaling = 1;
+            break;
+        case 'b':
+            batchSize = atoi(optarg);
+            break;
+        case 'A':
+            adaptiveBatch = 1;
+            break;
+        case 'w':
+            waitStrategy = -1;
+            for (int i = WAIT_SPIN; i <= WAIT_BLOCK; i++) {
+                if (strcmp(optarg, waitNames[i]) == 0) {
+                    waitStrategy = i;
+                }
+            }
+            if (waitStrategy < 0) {
+                fprintf(stderr, "Unknown wait strategy: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'L':
+            latencyInterval = atol(optarg);
+            break;
+        case 'T':
+            trials = atoi(optarg);
+            break;
+        case 'W':
+            warmup = atol(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-m sem|spsc|mpmc] [-n items] [-s slots] [-z item bytes] [-P producers] "
+                            "[-C consumers] [-a] [-S] [-b batch] [-A] [-w spin|adaptive|block] "
+                            "[-L interval us] [-T trials] [-W warm-up]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (items <= 0 || slots <= 0) {
+        fprintf(stderr, "Items and slots must be positive\n");
+        return 1;
+    }
+    if (itemSize < sizeof(Item) || itemSize > MAX_ITEM_SIZE || itemSize % sizeof(Item) != 0) {
+        fprintf(stderr, "Item size must be a multiple of %zu between %zu and %d\n", sizeof(Item), sizeof(Item),
+                MAX_ITEM_SIZE);
+        return 1;
+    }
+    if (trials < 0) {
+        fprintf(stderr, "Trials must not be negative\n");
+        return 1;
+    }
+    if (batchSize < 0 || batchSize > MAX_BATCH) {
+        fprintf(stderr, "Batch size must be between 0 and %d\n", MAX_BATCH);
+        return 1;
+    }
+    if (adaptiveBatch && batchSize == 0) {
+        batchSize = 64;
+    }
+    if (producers < 1 || producers > MAX_THREADS || consumers < 1 || consumers > MAX_THREADS) {
+        fprintf(stderr, "Producers and consumers must be between 1 and %d\n", MAX_THREADS);
+        return 1;
+    }
+
+    if (sysconf(_SC_NPROCESSORS_ONLN) < 2) {
+        spinLimit = 0;
+    }
+
+    if (scaling) {
+        scalingSweep(items, slots, pin);
+        return 0;
+    }
+
+    if (latencyInterval > 0) {
+        const char *name = mode ? mode : "spsc";
+        for (int i = 0; i < queueCount; i++) {
+            if (strcmp(name, queues[i].name) == 0) {
+                latencyTest(&queues[i], itemsSet ? items : 20000, slots, latencyInterval, pin);
+                return 0;
+            }
+        }
+        fprintf(stderr, "Unknown mode: %s\n", name);
+        return 1;
+    }
+
+    if (warmup < 0) {
+        warmup = items / 10;
+    }
+    if (trials > 0) {
+        printf("%ld items x %d trials after %ld warm-up items, %d slots of %zu bytes\n\n", items, trials, warmup,
+               slots, itemSize);
+        printf("Mode\tThreads\tItems/sec\tStddev\tMin\tMax\tp50 us\tp90 us\tp99 us\tp99.9 us\tp99.99 us\tmax us\n");
+    } else {
+        printf("Mode\tThreads\tItems\t\tSlots\tSeconds\t\tItems/sec\n");
+    }
+    int ran = 0;
+    for (int i = 0; i < queueCount; i++) {
+        if (mode && strcmp(mode, queues[i].name) != 0) {
+            continue;
+        }
+        ran = 1;
+        if (!queues[i].multi && (producers > 1 || consumers > 1)) {
+            if (mode) {
+                fprintf(stderr, "%s supports exactly one producer and one consumer\n", queues[i].name);
+                return 1;
+            }
+            continue;
+        }
+        if (trials > 0) {
+            benchmarkHarness(&queues[i], items, slots, producers, consumers, pin, warmup, trials);
+            continue;
+        }
+        double elapsed = runQueue(&queues[i], items, slots, producers, consumers, pin, NULL);
+        printf("%s\t%dx%d\t%ld\t%d\t%.4f\t\t%.0f\n", queues[i].name, producers, consumers, items, slots,
+               elapsed, items / elapsed);
+    }
+    if (!ran) {
+        fprintf(stderr, "Unknown mode: %s\n", mode);
+        return 1;
+    }
+
+    return 0;
+}
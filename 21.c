@@ -0,0 +1,392 @@
+// Run the producer-consumer bounded buffer from 7.c with coroutines instead of OS threads, so one
+// channel can be fed by a hundred thousand producers. Producers and consumers are stackless
+// coroutines that suspend when the channel is full or empty and are resumed by the other side.
+// A small pool of worker threads runs them, and an idle worker steals work from a busy one.
+//
+// Compile: gcc -O2 21.c -o coro_chan -lpthread
+// Usage:   ./coro_chan [-p producers] [-c consumers] [-n items] [-s slots] [-t threads]
+//            -p  number of producer coroutines (default 100000)
+//            -c  number of consumer coroutines (default 4)
+//            -n  items sent by every producer (default 10)
+//            -s  number of channel slots (default BUFFER_SIZE)
+//            -t  number of worker threads (default: one per online CPU)
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BUFFER_SIZE 5
+#define CACHE_LINE 64
+#define MAX_WORKERS 64
+
+#define CO_PARKED 0 // The coroutine is waiting on a channel; whoever wakes it requeues it
+#define CO_DONE 1   // The coroutine has returned
+
+// Stackless coroutines: a step function resumes at the line saved in its task, so a coroutine
+// costs only its task struct. Anything that must survive a suspension lives in the task.
+#define CO_BEGIN(t) switch ((t)->line) { case 0:
+#define CO_AWAIT(t, attempt)                                                                     \
+    do {                                                                                         \
+        (t)->line = __LINE__;                                                                    \
+        __attribute__((fallthrough));                                                            \
+    case __LINE__:                                                                               \
+        if (!(attempt)) {                                                                        \
+            return CO_PARKED; /* Already on a wait list: the task must not be touched again */   \
+        }                                                                                        \
+    } while (0)
+#define CO_END(t) } return CO_DONE
+
+typedef unsigned long Item;
+
+struct Worker;
+
+struct Task {
+    int (*step)(struct Task *task, struct Worker *self); // Runs until the coroutine parks or ends
+    int line;                                             // Resume point, 0 before the first step
+    struct Task *prev, *next;                             // Deque links, or wait list link
+};
+
+struct WaitList {
+    struct Task *head, *tail;
+};
+
+// The bounded buffer from 7.c. A coroutine that finds it full (or empty) joins the senders (or
+// receivers) list under the lock; the next receive (or send) moves one waiter back to a deque.
+struct Channel {
+    pthread_mutex_t mutex;
+    Item *buffer;
+    int size;
+    int in;    // Points to the next empty slot
+    int out;   // Points to the next full slot
+    int count; // Number of full slots
+    struct WaitList senders;
+    struct WaitList receivers;
+};
+
+struct Producer {
+    struct Task task;
+    long next; // Next item to send
+    long last; // Last item to send
+};
+
+struct Consumer {
+    struct Task task;
+    long left; // Items still to receive
+    Item item;
+};
+
+// Tasks ready to run. The owner pushes and pops at the bottom (newest first, while its data is
+// still in cache); thieves take from the top, where the oldest tasks are.
+struct Deque {
+    pthread_mutex_t mutex;
+    struct Task *top, *bottom;
+};
+
+struct Worker {
+    _Alignas(CACHE_LINE) struct Deque deque;
+    unsigned seed;  // Picks steal victims
+    Item sent;      // Sum of every item sent by coroutines on this worker
+    Item received;  // Sum of every item received
+    long resumes;   // Steps run
+    long parks;     // Suspensions on a full or empty channel
+    long steals;    // Tasks taken from another worker
+};
+
+struct Channel channel;
+struct Worker workers[MAX_WORKERS];
+int workerCount;
+atomic_long liveTasks; // Coroutines that have not returned yet
+
+double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Resident set size of the process right now
+long residentKb() {
+    FILE *f = fopen("/proc/self/statm", "r");
+    long pages = 0, resident = 0;
+
+    if (f) {
+        if (fscanf(f, "%ld %ld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(f);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+void waitListPush(struct WaitList *list, struct Task *t) {
+    t->next = NULL;
+    if (list->tail) list->tail->next = t; else list->head = t;
+    list->tail = t;
+}
+
+struct Task *waitListPop(struct WaitList *list) {
+    struct Task *t = list->head;
+
+    if (t) {
+        list->head = t->next;
+        if (!list->head) list->tail = NULL;
+    }
+    return t;
+}
+
+void dequePushBottom(struct Deque *d, struct Task *t) {
+    pthread_mutex_lock(&d->mutex);
+    t->next = NULL;
+    t->prev = d->bottom;
+    if (d->bottom) d->bottom->next = t; else d->top = t;
+    d->bottom = t;
+    pthread_mutex_unlock(&d->mutex);
+}
+
+struct Task *dequePopBottom(struct Deque *d) {
+    pthread_mutex_lock(&d->mutex);
+    struct Task *t = d->bottom;
+    if (t) {
+        d->bottom = t->prev;
+        if (d->bottom) d->bottom->next = NULL; else d->top = NULL;
+    }
+    pthread_mutex_unlock(&d->mutex);
+    return t;
+}
+
+struct Task *dequePopTop(struct Deque *d) {
+    pthread_mutex_lock(&d->mutex);
+    struct Task *t = d->top;
+    if (t) {
+        d->top = t->next;
+        if (d->top) d->top->prev = NULL; else d->bottom = NULL;
+    }
+    pthread_mutex_unlock(&d->mutex);
+    return t;
+}
+
+// Send one item, or park t on the senders list and return 0 when the buffer is full
+int chanTrySend(struct Channel *ch, struct Task *t, struct Worker *self, Item item) {
+    pthread_mutex_lock(&ch->mutex);
+    if (ch->count == ch->size) {
+        waitListPush(&ch->senders, t);
+        pthread_mutex_unlock(&ch->mutex);
+        self->parks++;
+        return 0;
+    }
+    ch->buffer[ch->in] = item;
+    ch->in = (ch->in + 1) % ch->size;
+    ch->count++;
+    struct Task *woken = waitListPop(&ch->receivers);
+    pthread_mutex_unlock(&ch->mutex);
+
+    if (woken) {
+        dequePushBottom(&self->deque, woken); // Runs next on this worker unless it is stolen
+    }
+    return 1;
+}
+
+// Receive one item, or park t on the receivers list and return 0 when the buffer is empty
+int chanTryRecv(struct Channel *ch, struct Task *t, struct Worker *self, Item *item) {
+    pthread_mutex_lock(&ch->mutex);
+    if (ch->count == 0) {
+        waitListPush(&ch->receivers, t);
+        pthread_mutex_unlock(&ch->mutex);
+        self->parks++;
+        return 0;
+    }
+    *item = ch->buffer[ch->out];
+    ch->out = (ch->out + 1) % ch->size;
+    ch->count--;
+    struct Task *woken = waitListPop(&ch->senders);
+    pthread_mutex_unlock(&ch->mutex);
+
+    if (woken) {
+        dequePushBottom(&self->deque, woken);
+    }
+    return 1;
+}
+
+int producerStep(struct Task *task, struct Worker *self) {
+    struct Producer *p = (struct Producer *)task;
+
+    CO_BEGIN(task);
+    while (p->next <= p->last) {
+        CO_AWAIT(task, chanTrySend(&channel, task, self, (Item)p->next)); // Produce an item
+        self->sent += (Item)p->next++;
+    }
+    CO_END(task);
+}
+
+int consumerStep(struct Task *task, struct Worker *self) {
+    struct Consumer *c = (struct Consumer *)task;
+
+    CO_BEGIN(task);
+    while (c->left > 0) {
+        CO_AWAIT(task, chanTryRecv(&channel, task, self, &c->item));
+        self->received += c->item; // Consume an item
+        c->left--;
+    }
+    CO_END(task);
+}
+
+// Take the oldest task of some other worker, starting from a random victim
+struct Task *steal(struct Worker *self) {
+    int start = rand_r(&self->seed) % workerCount;
+
+    for (int i = 0; i < workerCount; i++) {
+        struct Worker *victim = &workers[(start + i) % workerCount];
+        if (victim == self) {
+            continue;
+        }
+        struct Task *t = dequePopTop(&victim->deque);
+        if (t) {
+            self->steals++;
+            return t;
+        }
+    }
+    return NULL;
+}
+
+void *workerLoop(void *arg) {
+    struct Worker *self = arg;
+
+    while (atomic_load_explicit(&liveTasks, memory_order_acquire) > 0) {
+        struct Task *t = dequePopBottom(&self->deque);
+        if (!t) {
+            t = steal(self);
+        }
+        if (!t) {
+            sched_yield(); // Every runnable task is on another worker, or is running
+            continue;
+        }
+        self->resumes++;
+        if (t->step(t, self) == CO_DONE) {
+            atomic_fetch_sub_explicit(&liveTasks, 1, memory_order_release);
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    long producers = 100000;
+    long consumers = 4;
+    long items = 10;
+    int slots = BUFFER_SIZE;
+    int opt;
+
+    workerCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    while ((opt = getopt(argc, argv, "p:c:n:s:t:")) != -1) {
+        switch (opt) {
+        case 'p':
+            producers = atol(optarg);
+            break;
+        case 'c':
+            consumers = atol(optarg);
+            break;
+        case 'n':
+            items = atol(optarg);
+            break;
+        case 's':
+            slots = atoi(optarg);
+            break;
+        case 't':
+            workerCount = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-p producers] [-c consumers] [-n items] [-s slots] [-t threads]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (producers <= 0 || consumers <= 0 || items <= 0 || slots <= 0) {
+        fprintf(stderr, "Producers, consumers, items and slots must be positive\n");
+        return 1;
+    }
+    if (workerCount > MAX_WORKERS) {
+        workerCount = MAX_WORKERS;
+    }
+    if (workerCount < 1) {
+        workerCount = 1;
+    }
+
+    long total = producers * items;
+    pthread_mutex_init(&channel.mutex, NULL);
+    channel.buffer = malloc(slots * sizeof(Item));
+    channel.size = slots;
+
+    long rssBefore = residentKb();
+    struct Producer *prod = calloc(producers, sizeof(struct Producer));
+    struct Consumer *cons = calloc(consumers, sizeof(struct Consumer));
+
+    for (int w = 0; w < workerCount; w++) {
+        pthread_mutex_init(&workers[w].deque.mutex, NULL);
+        workers[w].seed = w + 1;
+    }
+    // Spread the coroutines round robin; consumers go last so they start first and park
+    for (long i = 0; i < producers; i++) {
+        prod[i].task.step = producerStep;
+        prod[i].next = i * items + 1;
+        prod[i].last = (i + 1) * items;
+        dequePushBottom(&workers[i % workerCount].deque, &prod[i].task);
+    }
+    for (long i = 0; i < consumers; i++) {
+        cons[i].task.step = consumerStep;
+        cons[i].left = total / consumers + (i < total % consumers);
+        dequePushBottom(&workers[i % workerCount].deque, &cons[i].task);
+    }
+    atomic_store(&liveTasks, producers + consumers);
+    long rssGrowth = residentKb() - rssBefore;
+
+    pthread_t threads[MAX_WORKERS];
+    double start = nowSeconds();
+    for (int w = 0; w < workerCount; w++) {
+        pthread_create(&threads[w], NULL, workerLoop, &workers[w]);
+    }
+    for (int w = 0; w < workerCount; w++) {
+        pthread_join(threads[w], NULL);
+    }
+    double elapsed = nowSeconds() - start;
+
+    Item sent = 0, received = 0;
+    long resumes = 0, parks = 0, steals = 0;
+    for (int w = 0; w < workerCount; w++) {
+        sent += workers[w].sent;
+        received += workers[w].received;
+        resumes += workers[w].resumes;
+        parks += workers[w].parks;
+        steals += workers[w].steals;
+    }
+    if (sent != received) {
+        fprintf(stderr, "Checksum mismatch, items were lost or duplicated\n");
+    }
+
+    pthread_attr_t attr;
+    size_t stackSize;
+    pthread_attr_init(&attr);
+    pthread_attr_getstacksize(&attr, &stackSize);
+    pthread_attr_destroy(&attr);
+
+    printf("%ld producer and %ld consumer coroutines on %d worker threads, %d slots\n\n", producers, consumers,
+           workerCount, slots);
+    printf("Items moved:          %ld\n", total);
+    printf("Seconds:              %.4f\n", elapsed);
+    printf("Items/sec:            %.0f\n", total / elapsed);
+    printf("Resumes:              %ld (%ld parks, %ld steals)\n", resumes, parks, steals);
+    printf("Bytes per producer:   %zu (a thread would reserve a %zu KB stack)\n", sizeof(struct Producer),
+           stackSize / 1024);
+    printf("Bytes per consumer:   %zu\n", sizeof(struct Consumer));
+    printf("RSS for coroutines:   %ld KB (%.1f bytes each)\n", rssGrowth,
+           rssGrowth * 1024.0 / (producers + consumers));
+
+    free(prod);
+    free(cons);
+    free(channel.buffer);
+    pthread_mutex_destroy(&channel.mutex);
+    return 0;
+}
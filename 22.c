@@ -0,0 +1,1110 @@
+// Replace the reader-writer lock from 8.c (two mutexes and read_count, where the last reader
+// unlocks a mutex that another reader locked) with reader-writer locks built on atomics that
+// sleep on a futex. Reader-preferring, writer-preferring and phase-fair modes are compared by
+// their aggregate throughput and by the longest time a reader or writer waited for the lock.
+// A seqlock mode lets readers retry on a sequence counter instead of writing shared memory,
+// and an RCU mode lets writers publish a new copy of the data while readers keep the old one.
+// A big-reader lock gives every thread its own reader flag, so readers never share a line and
+// a writer pays instead by scanning every flag. pthread_rwlock_t and the 8.c scheme run as
+// baselines, and every run reports latency percentiles and how evenly the threads progressed.
+// Latency is sampled on one operation in LATENCY_SAMPLE, so the two clock reads do not weigh
+// on the throughput of short critical sections.
+// The shared data is a payload of several words that every writer increments together, so a
+// read that sees different words was torn.
+//
+// Compile: gcc -O2 22.c -o rwlock -lpthread
+// Usage:   ./rwlock [-m mutex|pthread|reader|writer|fair|seqlock|rcu|brlock] [-r readers] [-w writers] [-t seconds]
+//                   [-d words] [-c cycles] [-p read %] [-S] [-B]
+//            -m  lock mode to run (default: all of them)
+//            -r  number of reader threads (default 4)
+//            -w  number of writer threads (default 2)
+//            -t  seconds to run each mode (default 1)
+//            -d  words in the shared payload (default 8)
+//            -c  extra work inside every critical section, in dependent multiply-adds (default 0)
+//            -p  every thread mixes reads and writes, with this percentage of reads
+//            -S  read throughput of every mode from 1 to 64 reader threads (with -p: mixed threads)
+//            -B  read throughput with 99% and then 99.9% reads, from 1 to 64 mixed threads
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#define CACHE_LINE 64
+#define SPIN_LIMIT 100 // Failed checks before a waiting thread sleeps on the futex
+#define MAX_THREADS 128
+#define MAX_WORDS 64
+#define LATENCY_SAMPLE 16 // Every thread times one operation in this many (a power of two)
+
+#define HIST_SUB_BITS 5 // 32 sub-buckets per power of two, about 3% error
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS (60 * HIST_SUB_BUCKETS)
+
+// Futex reader-writer lock state: a reader count, waiting writers and the writer-held bit
+#define RW_READER 1u
+#define RW_READERS_MASK 0xffffu
+#define RW_WAITING_WRITER (1u << 16)
+#define RW_WAITING_MASK (0x3fffu << 16)
+#define RW_WRITER (1u << 30)
+
+// Phase-fair ticket lock (Brandenburg and Anderson's PF-T): readers count in rin/rout in steps of
+// PF_READER, and the low bits of rin say whether a writer is present and which phase it is in
+#define PF_READER 0x100u
+#define PF_WRITER_BITS 0x3u
+#define PF_PRESENT 0x2u
+#define PF_PHASE 0x1u
+
+// Log-linear latency histogram (HDR style): exact below 64, then 32 buckets per power of two
+struct Histogram {
+    long long count;
+    long long max;
+    long long buckets[HIST_BUCKETS];
+};
+
+struct RunResult {
+    double readsPerSec;
+    double writesPerSec;
+    double fairness;            // Most over fewest operations of threads doing the same work
+    struct Histogram readHist;  // Latency of every read, lock wait included
+    struct Histogram writeHist;
+    long torn;
+    long retired;     // RCU: versions replaced by writers
+    long reclaimed;   // RCU: versions freed while the readers were running
+    long peakPending; // RCU: most versions waiting for readers to leave at once
+};
+
+// A lock protecting the shared data; read() and write() each take and release it once
+struct LockOps {
+    const char *name;
+    void *(*create)(void);
+    void (*destroy)(void *lock);
+    long (*read)(void *lock); // Returns the value it read, or -1 for a torn read
+    void (*write)(void *lock);
+    void (*reclaimStats)(void *lock, struct RunResult *result); // Optional, for deferred freeing
+};
+
+struct PthreadLock {
+    pthread_rwlock_t rwlock;
+    long data[MAX_WORDS];
+};
+
+// The scheme from 8.c: mutex guards read_count and the first reader in locks wrt for all of
+// them. wrt is a binary semaphore here because the last reader out, which releases it, is
+// usually not the reader that took it, and unlocking another thread's mutex is undefined.
+struct MutexLock {
+    pthread_mutex_t mutex;
+    sem_t wrt;
+    int readCount;
+    long data[MAX_WORDS];
+};
+
+// Reader or writer preferring lock. A reader may enter while no writer holds the lock; in the
+// writer-preferring mode it also stays out while any writer is waiting. Sleepers wait on the
+// state word itself and are only woken when someone is known to be asleep.
+struct FutexRwLock {
+    _Alignas(CACHE_LINE) atomic_uint state;
+    atomic_uint sleepers;
+    int preferWriters;
+    long data[MAX_WORDS]; // Shared data (critical section)
+};
+
+// Phase-fair: readers and writers alternate phases, so a writer waits for at most the readers
+// that came before it, and a reader waits for at most one writer
+struct PhaseFairLock {
+    _Alignas(CACHE_LINE) atomic_uint rin;  // Readers that have arrived, plus the writer bits
+    _Alignas(CACHE_LINE) atomic_uint rout; // Readers that have left
+    _Alignas(CACHE_LINE) atomic_uint win;  // Writer tickets handed out
+    _Alignas(CACHE_LINE) atomic_uint wout; // Writer tickets served
+    atomic_uint sleepers;
+    long data[MAX_WORDS];
+};
+
+// Sequence lock: writers make seq odd, update the payload and make it even again. Readers
+// copy the payload between two reads of seq and retry if it was odd or changed, so a read
+// never stores to shared memory. The payload words are atomics only so that the racing
+// copy is defined behaviour; they are accessed with relaxed loads and stores.
+struct SeqLock {
+    _Alignas(CACHE_LINE) atomic_uint seq;
+    pthread_mutex_t writerMutex; // Writers still exclude each other
+    atomic_long data[MAX_WORDS];
+};
+
+// One published copy of the payload. It is never changed once published; a writer builds a new
+// version and swaps the pointer, then retires the old one to the limbo list.
+struct RcuVersion {
+    struct RcuVersion *next;  // Limbo list link
+    unsigned long retiredAt;  // Global epoch when it was replaced
+    long data[];              // payloadWords words
+};
+
+struct ReaderSlot {
+    _Alignas(CACHE_LINE) atomic_ulong epoch; // Epoch the thread's read started in, 0 when outside
+};
+
+// Epoch-based RCU. A reader copies the global epoch into its own slot, reads the current version
+// and clears the slot, so it only writes its own cache line. A version retired in epoch e can be
+// freed once every active slot holds a later epoch: those readers started after the swap.
+struct RcuLock {
+    _Alignas(CACHE_LINE) _Atomic(struct RcuVersion *) current;
+    _Alignas(CACHE_LINE) atomic_ulong epoch;
+    pthread_mutex_t writerMutex;
+    struct RcuVersion *limboHead, *limboTail; // Retired versions, oldest first
+    long pending;                             // Versions in limbo
+    long peakPending;
+    long retired;
+    long reclaimed;
+    struct ReaderSlot slots[2 * MAX_THREADS];
+};
+
+struct BrSlot {
+    _Alignas(CACHE_LINE) atomic_uint reading; // 1 while this thread is inside a read
+};
+
+// Big-reader lock: a reader raises its own flag and checks that no writer is active; a writer
+// raises the writer flag and then waits for every reader flag to drop
+struct BrLock {
+    _Alignas(CACHE_LINE) atomic_uint writer;
+    atomic_uint sleepers;
+    pthread_mutex_t writerMutex;
+    struct BrSlot slots[2 * MAX_THREADS];
+    long data[MAX_WORDS];
+};
+
+struct ThreadArgs {
+    int id; // Index of the thread's RCU reader slot
+    const struct LockOps *ops;
+    void *lock;
+    int writer;            // Only writes; otherwise only reads, unless readPpm mixes them
+    long reads;
+    long writes;
+    long torn;             // Reads that saw a half-written payload
+    struct Histogram readHist;
+    struct Histogram writeHist;
+};
+
+
+int spinLimit = SPIN_LIMIT; // Zero on a single CPU, where spinning only delays the lock holder
+int payloadWords = 8;
+int threadCount;          // Threads in the current run; their ids index the per-thread slots
+long readPpm = -1;        // Reads per million operations of a mixed thread, -1 for fixed roles
+int criticalLength = 0;   // Extra work in every critical section
+__thread int threadIndex; // This thread's id
+atomic_int stopFlag;
+pthread_barrier_t startBarrier;
+
+double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+long long nowNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void histRecord(struct Histogram *h, long long value) {
+    int index;
+
+    if (value < 2 * HIST_SUB_BUCKETS) {
+        index = value < 0 ? 0 : (int)value;
+    } else {
+        int shift = 63 - __builtin_clzll(value) - HIST_SUB_BITS;
+        index = (shift + 1) * HIST_SUB_BUCKETS + (int)(value >> shift) - HIST_SUB_BUCKETS;
+    }
+    h->buckets[index]++;
+    h->count++;
+    if (value > h->max) {
+        h->max = value;
+    }
+}
+
+// Upper bound of the bucket holding quantile q (0..1), capped at the largest value seen
+long long histQuantile(const struct Histogram *h, double q) {
+    long long rank = (long long)(q * h->count + 0.5);
+    long long seen = 0;
+
+    if (rank < 1) {
+        rank = 1;
+    }
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            if (i < 2 * HIST_SUB_BUCKETS) {
+                return i;
+            }
+            int shift = i / HIST_SUB_BUCKETS - 1;
+            long long upper = ((long long)(i % HIST_SUB_BUCKETS + HIST_SUB_BUCKETS + 1) << shift) - 1;
+            return upper < h->max ? upper : h->max;
+        }
+    }
+    return h->max;
+}
+
+// Add every bucket of src to dst
+void histMerge(struct Histogram *dst, const struct Histogram *src) {
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+    dst->count += src->count;
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+}
+
+static inline void futexWait(atomic_uint *addr, unsigned expected) {
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+static inline void futexWake(atomic_uint *addr, int count) {
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// Called while *addr still holds seen: spin a little, then sleep until the word changes
+static inline void waitChange(atomic_uint *addr, unsigned seen, atomic_uint *sleepers, int *spins) {
+    if (++*spins < spinLimit) {
+        cpuRelax();
+        return;
+    }
+    atomic_fetch_add(sleepers, 1); // Sequentially consistent, pairs with wakeAll
+    if (atomic_load(addr) == seen) {
+        futexWait(addr, seen);
+    }
+    atomic_fetch_sub(sleepers, 1);
+    *spins = 0;
+}
+
+// After changing *addr with a sequentially consistent update, wake everyone sleeping on it
+static inline void wakeAll(atomic_uint *addr, atomic_uint *sleepers) {
+    if (atomic_load(sleepers) > 0) {
+        futexWake(addr, INT_MAX);
+    }
+}
+
+// Stand-in for real work done while holding the lock
+static inline void criticalWork() {
+    unsigned long x = 1;
+
+    for (int i = 0; i < criticalLength; i++) {
+        x = x * 6364136223846793005UL + 1442695040888963407UL;
+        __asm__ __volatile__("" : "+r"(x)); // One dependent step each, never folded away
+    }
+}
+
+// Every word holds the same count unless the copy was torn
+static inline long checkWords(const long *data) {
+    long first = data[0];
+
+    for (int i = 1; i < payloadWords; i++) {
+        if (data[i] != first) {
+            return -1;
+        }
+    }
+    return first;
+}
+
+// Reading the data (critical section)
+static inline long readData(const long *data) {
+    criticalWork();
+    return checkWords(data);
+}
+
+// Writing the data (critical section)
+static inline void writeData(long *data) {
+    criticalWork();
+    for (int i = 0; i < payloadWords; i++) {
+        data[i]++;
+    }
+}
+
+void *pthreadCreate() {
+    struct PthreadLock *l = calloc(1, sizeof(struct PthreadLock));
+
+    pthread_rwlock_init(&l->rwlock, NULL);
+    return l;
+}
+
+void pthreadDestroy(void *lock) {
+    struct PthreadLock *l = lock;
+
+    pthread_rwlock_destroy(&l->rwlock);
+    free(l);
+}
+
+long pthreadRead(void *lock) {
+    struct PthreadLock *l = lock;
+
+    pthread_rwlock_rdlock(&l->rwlock);
+    long value = readData(l->data);
+    pthread_rwlock_unlock(&l->rwlock);
+    return value;
+}
+
+void pthreadWrite(void *lock) {
+    struct PthreadLock *l = lock;
+
+    pthread_rwlock_wrlock(&l->rwlock);
+    writeData(l->data);
+    pthread_rwlock_unlock(&l->rwlock);
+}
+
+void *mutexCreate() {
+    struct MutexLock *l = calloc(1, sizeof(struct MutexLock));
+
+    pthread_mutex_init(&l->mutex, NULL);
+    sem_init(&l->wrt, 0, 1);
+    return l;
+}
+
+void mutexDestroy(void *lock) {
+    struct MutexLock *l = lock;
+
+    pthread_mutex_destroy(&l->mutex);
+    sem_destroy(&l->wrt);
+    free(l);
+}
+
+long mutexRead(void *lock) {
+    struct MutexLock *l = lock;
+
+    pthread_mutex_lock(&l->mutex);
+    if (++l->readCount == 1) {
+        sem_wait(&l->wrt); // First reader in locks out the writers
+    }
+    pthread_mutex_unlock(&l->mutex);
+
+    long value = readData(l->data);
+
+    pthread_mutex_lock(&l->mutex);
+    if (--l->readCount == 0) {
+        sem_post(&l->wrt); // Last reader out lets them back in
+    }
+    pthread_mutex_unlock(&l->mutex);
+    return value;
+}
+
+void mutexWrite(void *lock) {
+    struct MutexLock *l = lock;
+
+    sem_wait(&l->wrt);
+    writeData(l->data);
+    sem_post(&l->wrt);
+}
+
+void *rwCreate(int preferWriters) {
+    struct FutexRwLock *l = aligned_alloc(CACHE_LINE, sizeof(struct FutexRwLock));
+
+    memset(l, 0, sizeof(*l));
+    atomic_init(&l->state, 0);
+    atomic_init(&l->sleepers, 0);
+    l->preferWriters = preferWriters;
+    return l;
+}
+
+void *rwCreateReaderPreferring() {
+    return rwCreate(0);
+}
+
+void *rwCreateWriterPreferring() {
+    return rwCreate(1);
+}
+
+void rwDestroy(void *lock) {
+    free(lock);
+}
+
+void rwReadLock(struct FutexRwLock *l) {
+    unsigned blockers = l->preferWriters ? RW_WRITER | RW_WAITING_MASK : RW_WRITER;
+    int spins = 0;
+
+    for (;;) {
+        unsigned s = atomic_load_explicit(&l->state, memory_order_relaxed);
+        if (s & blockers) {
+            waitChange(&l->state, s, &l->sleepers, &spins);
+        } else if (atomic_compare_exchange_weak_explicit(&l->state, &s, s + RW_READER, memory_order_acquire,
+                                                         memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+void rwReadUnlock(struct FutexRwLock *l) {
+    unsigned s = atomic_fetch_sub(&l->state, RW_READER);
+
+    if ((s & RW_READERS_MASK) == RW_READER) {
+        wakeAll(&l->state, &l->sleepers); // Last reader out: a writer may be waiting
+    }
+}
+
+// The writer announces itself first, which is what holds back new readers when writers are preferred
+void rwWriteLock(struct FutexRwLock *l) {
+    int spins = 0;
+
+    atomic_fetch_add_explicit(&l->state, RW_WAITING_WRITER, memory_order_relaxed);
+    for (;;) {
+        unsigned s = atomic_load_explicit(&l->state, memory_order_relaxed);
+        if (s & (RW_WRITER | RW_READERS_MASK)) {
+            waitChange(&l->state, s, &l->sleepers, &spins);
+        } else if (atomic_compare_exchange_weak_explicit(&l->state, &s, s - RW_WAITING_WRITER + RW_WRITER,
+                                                         memory_order_acquire, memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+void rwWriteUnlock(struct FutexRwLock *l) {
+    atomic_fetch_sub(&l->state, RW_WRITER);
+    wakeAll(&l->state, &l->sleepers);
+}
+
+long rwRead(void *lock) {
+    struct FutexRwLock *l = lock;
+
+    rwReadLock(l);
+    long value = readData(l->data);
+    rwReadUnlock(l);
+    return value;
+}
+
+void rwWrite(void *lock) {
+    struct FutexRwLock *l = lock;
+
+    rwWriteLock(l);
+    writeData(l->data);
+    rwWriteUnlock(l);
+}
+
+void *pfCreate() {
+    struct PhaseFairLock *l = aligned_alloc(CACHE_LINE, sizeof(struct PhaseFairLock));
+
+    memset(l, 0, sizeof(*l));
+    atomic_init(&l->rin, 0);
+    atomic_init(&l->rout, 0);
+    atomic_init(&l->win, 0);
+    atomic_init(&l->wout, 0);
+    atomic_init(&l->sleepers, 0);
+    return l;
+}
+
+void pfDestroy(void *lock) {
+    free(lock);
+}
+
+// A reader that arrives during a write phase waits only until the writer bits change, which
+// happens when that writer leaves even if another writer is already queued behind it
+void pfReadLock(struct PhaseFairLock *l) {
+    unsigned w = atomic_fetch_add(&l->rin, PF_READER) & PF_WRITER_BITS;
+    int spins = 0;
+
+    if (w == 0) {
+        return;
+    }
+    for (;;) {
+        unsigned seen = atomic_load_explicit(&l->rin, memory_order_acquire);
+        if ((seen & PF_WRITER_BITS) != w) {
+            return;
+        }
+        waitChange(&l->rin, seen, &l->sleepers, &spins);
+    }
+}
+
+void pfReadUnlock(struct PhaseFairLock *l) {
+    atomic_fetch_add(&l->rout, PF_READER);
+    if (atomic_load(&l->rin) & PF_PRESENT) { // Sequentially consistent, pairs with pfWriteLock
+        wakeAll(&l->rout, &l->sleepers); // A writer may be draining the readers
+    }
+}
+
+// Writers queue on a ticket, then block new readers and wait for the readers already inside
+void pfWriteLock(struct PhaseFairLock *l) {
+    unsigned ticket = atomic_fetch_add(&l->win, 1);
+    int spins = 0;
+
+    for (;;) {
+        unsigned seen = atomic_load_explicit(&l->wout, memory_order_acquire);
+        if (seen == ticket) {
+            break;
+        }
+        waitChange(&l->wout, seen, &l->sleepers, &spins);
+    }
+
+    unsigned readers = atomic_fetch_add(&l->rin, PF_PRESENT | (ticket & PF_PHASE));
+    spins = 0;
+    for (;;) {
+        unsigned seen = atomic_load_explicit(&l->rout, memory_order_acquire);
+        if (seen == readers) {
+            return;
+        }
+        waitChange(&l->rout, seen, &l->sleepers, &spins);
+    }
+}
+
+void pfWriteUnlock(struct PhaseFairLock *l) {
+    atomic_fetch_and(&l->rin, ~PF_WRITER_BITS); // Ends the write phase for the waiting readers
+    wakeAll(&l->rin, &l->sleepers);
+    atomic_fetch_add(&l->wout, 1);
+    wakeAll(&l->wout, &l->sleepers);
+}
+
+long pfRead(void *lock) {
+    struct PhaseFairLock *l = lock;
+
+    pfReadLock(l);
+    long value = readData(l->data);
+    pfReadUnlock(l);
+    return value;
+}
+
+void pfWrite(void *lock) {
+    struct PhaseFairLock *l = lock;
+
+    pfWriteLock(l);
+    writeData(l->data);
+    pfWriteUnlock(l);
+}
+
+void *seqCreate() {
+    struct SeqLock *l = aligned_alloc(CACHE_LINE, sizeof(struct SeqLock));
+
+    memset(l, 0, sizeof(*l));
+    atomic_init(&l->seq, 0);
+    pthread_mutex_init(&l->writerMutex, NULL);
+    for (int i = 0; i < MAX_WORDS; i++) {
+        atomic_init(&l->data[i], 0);
+    }
+    return l;
+}
+
+void seqDestroy(void *lock) {
+    struct SeqLock *l = lock;
+
+    pthread_mutex_destroy(&l->writerMutex);
+    free(l);
+}
+
+long seqRead(void *lock) {
+    struct SeqLock *l = lock;
+    long copy[MAX_WORDS];
+    unsigned before, after;
+    int spins = 0;
+
+    do {
+        before = atomic_load_explicit(&l->seq, memory_order_acquire);
+        if (before & 1) {
+            // A writer is in the middle of an update; it may have been preempted there
+            if (++spins < spinLimit) {
+                cpuRelax();
+            } else {
+                sched_yield();
+            }
+            after = before + 1;
+            continue;
+        }
+        for (int i = 0; i < payloadWords; i++) {
+            copy[i] = atomic_load_explicit(&l->data[i], memory_order_relaxed);
+        }
+        criticalWork();
+        // Keeps the payload loads above from moving below the second read of seq
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&l->seq, memory_order_relaxed);
+    } while (before != after);
+
+    return checkWords(copy);
+}
+
+void seqWrite(void *lock) {
+    struct SeqLock *l = lock;
+
+    pthread_mutex_lock(&l->writerMutex);
+    unsigned seq = atomic_load_explicit(&l->seq, memory_order_relaxed);
+    atomic_store_explicit(&l->seq, seq + 1, memory_order_relaxed);
+    // Keeps the payload stores below from moving above the odd sequence number
+    atomic_thread_fence(memory_order_release);
+    criticalWork();
+    for (int i = 0; i < payloadWords; i++) {
+        long value = atomic_load_explicit(&l->data[i], memory_order_relaxed);
+        atomic_store_explicit(&l->data[i], value + 1, memory_order_relaxed);
+    }
+    atomic_store_explicit(&l->seq, seq + 2, memory_order_release);
+    pthread_mutex_unlock(&l->writerMutex);
+}
+
+void *rcuCreate() {
+    struct RcuLock *l = aligned_alloc(CACHE_LINE, sizeof(struct RcuLock));
+    struct RcuVersion *first = calloc(1, sizeof(struct RcuVersion) + payloadWords * sizeof(long));
+
+    memset(l, 0, sizeof(*l));
+    atomic_init(&l->current, first);
+    atomic_init(&l->epoch, 1);
+    pthread_mutex_init(&l->writerMutex, NULL);
+    for (int i = 0; i < 2 * MAX_THREADS; i++) {
+        atomic_init(&l->slots[i].epoch, 0);
+    }
+    return l;
+}
+
+void rcuDestroy(void *lock) {
+    struct RcuLock *l = lock;
+
+    while (l->limboHead) {
+        struct RcuVersion *v = l->limboHead;
+        l->limboHead = v->next;
+        free(v);
+    }
+    free(atomic_load(&l->current));
+    pthread_mutex_destroy(&l->writerMutex);
+    free(l);
+}
+
+// The epoch load is an acquire: a writer bumps the epoch only after swapping in the new version,
+// so a reader that sees epoch e + 1 also sees that swap and cannot load the version retired at e,
+// which the next reclaim may free. The slot store and the pointer load are sequentially
+// consistent, so a writer that sees the slot empty has already swapped the pointer before this
+// read could load it.
+long rcuRead(void *lock) {
+    struct RcuLock *l = lock;
+    struct ReaderSlot *slot = &l->slots[threadIndex];
+
+    atomic_store(&slot->epoch, atomic_load_explicit(&l->epoch, memory_order_acquire));
+    struct RcuVersion *v = atomic_load(&l->current);
+    long value = readData(v->data);
+    atomic_store_explicit(&slot->epoch, 0, memory_order_release);
+    return value;
+}
+
+// Free the oldest retired versions that no reader can still hold
+void rcuReclaim(struct RcuLock *l) {
+    unsigned long oldest = ULONG_MAX;
+
+    for (int i = 0; i < threadCount; i++) {
+        unsigned long e = atomic_load(&l->slots[i].epoch);
+        if (e != 0 && e < oldest) {
+            oldest = e;
+        }
+    }
+    while (l->limboHead && l->limboHead->retiredAt < oldest) {
+        struct RcuVersion *v = l->limboHead;
+        l->limboHead = v->next;
+        if (!l->limboHead) {
+            l->limboTail = NULL;
+        }
+        free(v);
+        l->pending--;
+        l->reclaimed++;
+    }
+}
+
+void rcuWrite(void *lock) {
+    struct RcuLock *l = lock;
+    struct RcuVersion *next = malloc(sizeof(struct RcuVersion) + payloadWords * sizeof(long));
+
+    pthread_mutex_lock(&l->writerMutex);
+    struct RcuVersion *old = atomic_load_explicit(&l->current, memory_order_relaxed);
+    memcpy(next->data, old->data, payloadWords * sizeof(long));
+    writeData(next->data);
+    atomic_exchange(&l->current, next); // Publish: readers from now on see the new version
+
+    old->next = NULL;
+    old->retiredAt = atomic_fetch_add(&l->epoch, 1);
+    if (l->limboTail) l->limboTail->next = old; else l->limboHead = old;
+    l->limboTail = old;
+    l->retired++;
+    if (++l->pending > l->peakPending) {
+        l->peakPending = l->pending;
+    }
+    rcuReclaim(l);
+    pthread_mutex_unlock(&l->writerMutex);
+}
+
+void rcuReclaimStats(void *lock, struct RunResult *result) {
+    struct RcuLock *l = lock;
+
+    result->retired = l->retired;
+    result->reclaimed = l->reclaimed;
+    result->peakPending = l->peakPending;
+}
+
+void *brCreate() {
+    struct BrLock *l = aligned_alloc(CACHE_LINE, sizeof(struct BrLock));
+
+    memset(l, 0, sizeof(*l));
+    atomic_init(&l->writer, 0);
+    atomic_init(&l->sleepers, 0);
+    pthread_mutex_init(&l->writerMutex, NULL);
+    for (int i = 0; i < 2 * MAX_THREADS; i++) {
+        atomic_init(&l->slots[i].reading, 0);
+    }
+    return l;
+}
+
+void brDestroy(void *lock) {
+    struct BrLock *l = lock;
+
+    pthread_mutex_destroy(&l->writerMutex);
+    free(l);
+}
+
+// The flag store and the writer load are sequentially consistent, as are the writer's own
+// store and flag loads, so either the reader sees the writer or the writer sees the reader
+void brReadLock(struct BrLock *l, struct BrSlot *slot) {
+    int spins = 0;
+
+    for (;;) {
+        atomic_store(&slot->reading, 1);
+        if (!atomic_load(&l->writer)) {
+            return;
+        }
+        atomic_store(&slot->reading, 0); // Back off so the writer can finish
+        wakeAll(&slot->reading, &l->sleepers);
+        while (atomic_load_explicit(&l->writer, memory_order_relaxed)) {
+            waitChange(&l->writer, 1, &l->sleepers, &spins);
+        }
+    }
+}
+
+void brReadUnlock(struct BrLock *l, struct BrSlot *slot) {
+    atomic_store(&slot->reading, 0);
+    if (atomic_load(&l->writer)) {
+        wakeAll(&slot->reading, &l->sleepers);
+    }
+}
+
+long brRead(void *lock) {
+    struct BrLock *l = lock;
+    struct BrSlot *slot = &l->slots[threadIndex];
+
+    brReadLock(l, slot);
+    long value = readData(l->data);
+    brReadUnlock(l, slot);
+    return value;
+}
+
+void brWrite(void *lock) {
+    struct BrLock *l = lock;
+
+    pthread_mutex_lock(&l->writerMutex);
+    atomic_store(&l->writer, 1);
+    for (int i = 0; i < threadCount; i++) {
+        int spins = 0;
+        while (atomic_load(&l->slots[i].reading)) {
+            waitChange(&l->slots[i].reading, 1, &l->sleepers, &spins);
+        }
+    }
+    writeData(l->data);
+    atomic_store(&l->writer, 0);
+    wakeAll(&l->writer, &l->sleepers);
+    pthread_mutex_unlock(&l->writerMutex);
+}
+
+const struct LockOps locks[] = {
+    {"mutex", mutexCreate, mutexDestroy, mutexRead, mutexWrite, NULL},
+    {"pthread", pthreadCreate, pthreadDestroy, pthreadRead, pthreadWrite, NULL},
+    {"reader", rwCreateReaderPreferring, rwDestroy, rwRead, rwWrite, NULL},
+    {"writer", rwCreateWriterPreferring, rwDestroy, rwRead, rwWrite, NULL},
+    {"fair", pfCreate, pfDestroy, pfRead, pfWrite, NULL},
+    {"seqlock", seqCreate, seqDestroy, seqRead, seqWrite, NULL},
+    {"rcu", rcuCreate, rcuDestroy, rcuRead, rcuWrite, rcuReclaimStats},
+    {"brlock", brCreate, brDestroy, brRead, brWrite, NULL},
+};
+const int lockCount = sizeof(locks) / sizeof(locks[0]);
+
+volatile long sink; // Keeps the reads from being optimised away
+
+void *worker(void *arg) {
+    struct ThreadArgs *args = arg;
+    unsigned long rng = 0x9e3779b97f4a7c15UL * (args->id + 1);
+    long seen = 0;
+    unsigned long ops = 0;
+
+    threadIndex = args->id;
+    pthread_barrier_wait(&startBarrier);
+    while (!atomic_load_explicit(&stopFlag, memory_order_relaxed)) {
+        int write = args->writer;
+        if (readPpm >= 0) {
+            rng ^= rng << 13; // xorshift64
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            write = (long)(rng % 1000000) >= readPpm;
+        }
+
+        int timed = (++ops & (LATENCY_SAMPLE - 1)) == 0;
+        long long start = timed ? nowNanos() : 0;
+        if (write) {
+            args->ops->write(args->lock);
+        } else {
+            long value = args->ops->read(args->lock);
+            if (value < 0) {
+                args->torn++;
+            }
+            seen += value;
+        }
+        long long waited = timed ? nowNanos() - start : 0;
+
+        if (write) {
+            args->writes++;
+            if (timed) {
+                histRecord(&args->writeHist, waited);
+            }
+        } else {
+            args->reads++;
+            if (timed) {
+                histRecord(&args->readHist, waited);
+            }
+        }
+    }
+    sink = seen;
+    return NULL;
+}
+
+// Run readers and writers against one lock for the given time
+struct RunResult runLock(const struct LockOps *ops, int readers, int writers, double seconds) {
+    pthread_t threads[2 * MAX_THREADS];
+    struct ThreadArgs *args = calloc(2 * MAX_THREADS, sizeof(struct ThreadArgs)); // Histograms are large
+    int total = readers + writers;
+    threadCount = total;
+    void *lock = ops->create();
+    long reads = 0, writes = 0;
+    long most[2] = {0, 0}, fewest[2] = {LONG_MAX, LONG_MAX}; // Per group of threads doing the same work
+    struct RunResult result;
+
+    memset(&result, 0, sizeof(result));
+    atomic_store(&stopFlag, 0);
+    pthread_barrier_init(&startBarrier, NULL, total + 1);
+    for (int i = 0; i < total; i++) {
+        args[i].id = i;
+        args[i].ops = ops;
+        args[i].lock = lock;
+        args[i].writer = i >= readers;
+        pthread_create(&threads[i], NULL, worker, &args[i]);
+    }
+
+    pthread_barrier_wait(&startBarrier);
+    double start = nowSeconds();
+    struct timespec pause = {(time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9)};
+    nanosleep(&pause, NULL);
+    atomic_store(&stopFlag, 1);
+    for (int i = 0; i < total; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed = nowSeconds() - start;
+    pthread_barrier_destroy(&startBarrier);
+
+    for (int i = 0; i < total; i++) {
+        long done = args[i].reads + args[i].writes;
+        int group = readPpm >= 0 ? 0 : args[i].writer;
+
+        reads += args[i].reads;
+        writes += args[i].writes;
+        histMerge(&result.readHist, &args[i].readHist);
+        histMerge(&result.writeHist, &args[i].writeHist);
+        result.torn += args[i].torn;
+        if (done > most[group]) {
+            most[group] = done;
+        }
+        if (done < fewest[group]) {
+            fewest[group] = done;
+        }
+    }
+    for (int group = 0; group < 2; group++) {
+        if (most[group] > 0) {
+            double ratio = fewest[group] > 0 ? (double)most[group] / fewest[group] : 1.0 / 0.0;
+            if (ratio > result.fairness) {
+                result.fairness = ratio;
+            }
+        }
+    }
+    free(args);
+    if (result.torn > 0) {
+        fprintf(stderr, "%s: %ld torn reads\n", ops->name, result.torn);
+    }
+    result.readsPerSec = reads / elapsed;
+    result.writesPerSec = writes / elapsed;
+    if (ops->reclaimStats) {
+        ops->reclaimStats(lock, &result);
+    }
+    ops->destroy(lock);
+    return result;
+}
+
+// Read throughput of every selected mode as the number of reader threads doubles up to 64. With
+// mixed threads it is the total thread count that doubles, and there are no dedicated writers.
+void readerSweep(const char *mode, int writers, double seconds) {
+    if (readPpm >= 0) {
+        writers = 0;
+    }
+    printf(readPpm >= 0 ? "Threads" : "Readers");
+    for (int i = 0; i < lockCount; i++) {
+        if (!mode || strcmp(mode, locks[i].name) == 0) {
+            printf("\t%s reads/sec", locks[i].name);
+        }
+    }
+    printf("\n");
+
+    for (int readers = 1; readers <= 64; readers *= 2) {
+        printf("%d", readers);
+        for (int i = 0; i < lockCount; i++) {
+            if (!mode || strcmp(mode, locks[i].name) == 0) {
+                printf("\t%.0f", runLock(&locks[i], readers, writers, seconds).readsPerSec);
+            }
+        }
+        printf("\n");
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *mode = NULL;
+    int readers = 4, writers = 2;
+    double seconds = 1;
+    int opt;
+
+    int sweep = 0, brBenchmark = 0;
+
+    while ((opt = getopt(argc, argv, "m:r:w:t:d:c:p:SB")) != -1) {
+        switch (opt) {
+        case 'm':
+            mode = optarg;
+            break;
+        case 'r':
+            readers = atoi(optarg);
+            break;
+        case 'w':
+            writers = atoi(optarg);
+            break;
+        case 't':
+            seconds = atof(optarg);
+            break;
+        case 'd':
+            payloadWords = atoi(optarg);
+            break;
+        case 'c':
+            criticalLength = atoi(optarg);
+            break;
+        case 'p':
+            readPpm = (long)(atof(optarg) * 10000 + 0.5);
+            if (readPpm < 0 || readPpm > 1000000) {
+                fprintf(stderr, "Read percentage must be between 0 and 100\n");
+                return 1;
+            }
+            break;
+        case 'S':
+            sweep = 1;
+            break;
+        case 'B':
+            brBenchmark = 1;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-m mutex|pthread|reader|writer|fair|seqlock|rcu|brlock] [-r readers] [-w writers] "
+                            "[-t seconds] [-d words] [-c cycles] [-p read %%] [-S] [-B]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (readers < 0 || readers > MAX_THREADS || writers < 0 || writers > MAX_THREADS || readers + writers == 0) {
+        fprintf(stderr, "Readers and writers must be between 0 and %d, and not both 0\n", MAX_THREADS);
+        return 1;
+    }
+    if (seconds <= 0) {
+        fprintf(stderr, "Seconds must be positive\n");
+        return 1;
+    }
+    if (payloadWords < 1 || payloadWords > MAX_WORDS) {
+        fprintf(stderr, "Payload words must be between 1 and %d\n", MAX_WORDS);
+        return 1;
+    }
+    int known = !mode;
+    for (int i = 0; i < lockCount; i++) {
+        known |= mode && strcmp(mode, locks[i].name) == 0;
+    }
+    if (!known) {
+        fprintf(stderr, "Unknown mode: %s\n", mode);
+        return 1;
+    }
+
+    if (sysconf(_SC_NPROCESSORS_ONLN) < 2) {
+        spinLimit = 0;
+    }
+
+    if (brBenchmark) {
+        const long ratios[] = {990000, 999000};
+        for (int i = 0; i < 2; i++) {
+            readPpm = ratios[i];
+            printf("%s%.1f%% reads, %d-word payload, %g s per run\n\n", i ? "\n" : "", readPpm / 1e4,
+                   payloadWords, seconds);
+            readerSweep(mode, 0, seconds);
+        }
+        return 0;
+    }
+
+    if (sweep) {
+        if (readPpm >= 0) {
+            printf("%.1f%% reads, %d-word payload, %g s per run\n\n", readPpm / 1e4, payloadWords, seconds);
+        } else {
+            printf("%d writers, %d-word payload, %g s per run\n\n", writers, payloadWords, seconds);
+        }
+        readerSweep(mode, writers, seconds);
+        return 0;
+    }
+
+    if (readPpm >= 0) {
+        printf("%d threads with %.1f%% reads, %d-word payload, %g s per mode\n\n", readers + writers, readPpm / 1e4,
+               payloadWords, seconds);
+    } else {
+        printf("%d readers, %d writers, %d-word payload, %g s per mode\n\n", readers, writers, payloadWords, seconds);
+    }
+    printf("Mode\t\tReads/sec\tWrites/sec\tOps/sec\t\tFairness\n");
+    struct RunResult *results = calloc(lockCount, sizeof(struct RunResult));
+    struct RunResult rcu;
+    memset(&rcu, 0, sizeof(rcu));
+    for (int i = 0; i < lockCount; i++) {
+        if (mode && strcmp(mode, locks[i].name) != 0) {
+            continue;
+        }
+        struct RunResult *r = &results[i];
+        *r = runLock(&locks[i], readers, writers, seconds);
+        printf("%-8s\t%.0f\t\t%.0f\t\t%.0f\t\t%.2f\n", locks[i].name, r->readsPerSec, r->writesPerSec,
+               r->readsPerSec + r->writesPerSec, r->fairness);
+        if (locks[i].reclaimStats) {
+            rcu = *r;
+        }
+    }
+
+    printf("\nLatency of one operation in %d per thread\n", LATENCY_SAMPLE);
+    printf("Latency us\tRead p50\tp99\tp99.9\tmax\t\tWrite p50\tp99\tp99.9\tmax\n");
+    for (int i = 0; i < lockCount; i++) {
+        if (mode && strcmp(mode, locks[i].name) != 0) {
+            continue;
+        }
+        const struct Histogram *rh = &results[i].readHist, *wh = &results[i].writeHist;
+        printf("%-8s\t%.2f\t\t%.2f\t%.2f\t%.1f\t\t%.2f\t\t%.2f\t%.2f\t%.1f\n", locks[i].name,
+               histQuantile(rh, 0.5) / 1e3, histQuantile(rh, 0.99) / 1e3, histQuantile(rh, 0.999) / 1e3, rh->max / 1e3,
+               histQuantile(wh, 0.5) / 1e3, histQuantile(wh, 0.99) / 1e3, histQuantile(wh, 0.999) / 1e3,
+               wh->max / 1e3);
+    }
+    free(results);
+
+    if (rcu.retired > 0) {
+        size_t versionBytes = sizeof(struct RcuVersion) + payloadWords * sizeof(long);
+        printf("\nRCU reclamation: %ld versions retired, %ld freed while reading (%.2f%%), "
+               "peak %ld waiting (%zu bytes)\n", rcu.retired, rcu.reclaimed, 100.0 * rcu.reclaimed / rcu.retired,
+               rcu.peakPending, rcu.peakPending * versionBytes);
+    }
+
+    return 0;
+}
@@ -0,0 +1,1356 @@
+// Run the Banker's algorithm from 9.c with the number of processes and resource types chosen at
+// runtime. max, allot and need are flat row-major matrices whose rows are padded to a whole
+// number of SIMD vectors, so the need <= work test for one process is a vector compare per
+// vector of resources instead of a scalar loop. The safety check is specialised at compile
+// time for the common small resource counts. A worklist check finishes each process as soon as
+// its last short resource is covered instead of rescanning them all, and a benchmark reports
+// safety checks per second for each variant. Requests and releases can also be checked one at a
+// time against the last safe sequence, or sent by client threads to an allocator thread that
+// admits them in batches.
+//
+// Compile: gcc -O2 23.c -o bankers -lpthread (add -march=native to use the widest vectors available)
+// Usage:   ./bankers [-n processes] [-m resources] [-k checks] [-s seed] [-w] [-u] [-G] [-r requests] [-c clients] [-t seconds] [-i]
+//            -n  number of processes (default 10000, or 5 with -i)
+//            -m  number of resource types (default 64, or 3 with -i)
+//            -k  safety checks per variant in the benchmark (default 20)
+//            -s  seed for the random state (default 1)
+//            -w  benchmark the worst case for repeated passes, where each pass finishes one process
+//            -u  make the state unsafe: two processes each need what only the other one holds
+//            -G  time calculateNeed() and every check on safe and unsafe states from 5 x 3 to 100,000 x 256
+//            -r  then run this many random requests and releases against the state, once with a
+//                full safety check per request and once reusing the last safe sequence
+//            -c  instead run the allocator service with this many client threads, one per process
+//            -t  seconds to run the allocator service (default 2)
+//            -i  read one state from stdin in the order 9.c asks for it (available, then the
+//                maximum and allocated resources of every process) and print the safe sequence
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#ifdef __AVX2__
+#define LANES 8 // Ints per vector
+#else
+#define LANES 4
+#endif
+#define VECTOR_BYTES (LANES * sizeof(int))
+
+typedef int VecInt __attribute__((vector_size(VECTOR_BYTES)));
+typedef long long VecWide __attribute__((vector_size(VECTOR_BYTES))); // Same bits, fewer lanes to test
+
+#define CACHE_LINE 64
+#define SPIN_LIMIT 100 // Checks of a pending op before its client sleeps on the futex
+#define OP_PENDING 0u
+#define OP_DONE 1u
+#define STARVE_ROUNDS 32 // Admission rounds a request may be passed over before the allocator holds others back
+
+#define HIST_SUB_BITS 5 // 32 sub-buckets per power of two, about 3% error
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS (60 * HIST_SUB_BUCKETS)
+
+struct Banker {
+    int n;       // Number of processes
+    int m;       // Number of resource types
+    int stride;  // Ints per matrix row: m rounded up to whole vectors, the padding is always 0
+    int *max;    // Maximum R that can be allocated to each process, n x stride
+    int *allot;  // R allocated to each process
+    int *need;   // R needs of each process
+    int *avail;  // Available R, stride ints
+    int *work;   // Scratch for the safety check
+    bool *finish;
+    int *byNeed; // Worklist check: for each resource, the processes in order of need, m x n
+    int *unsat;  // Worklist check: resources each process still needs more of than work holds
+    int *next;   // Worklist check: for each resource, the first process in byNeed not yet satisfied
+    unsigned *keys[2]; // Radix sort scratch, n each
+    int *ids[2];
+    int *seq;      // Requests: the safe sequence found by the last full check
+    int *seqPos;   // Requests: where each process is in seq
+    int *trySeq;   // Requests: the sequence a full check fills in before it is known to be safe
+    int *touched;  // Requests: the resources the requests being checked ask for, m
+    bool *isTouched;
+    int touchedCount;
+    bool seqValid; // Requests: seq is a safe sequence for the current state
+    long fastPath; // Requests decided by rechecking the prefix of seq
+    long fullChecks;
+};
+
+// Log-linear latency histogram (HDR style): exact below 64, then 32 buckets per power of two
+struct Histogram {
+    long long count;
+    long long max;
+    long long buckets[HIST_BUCKETS];
+};
+
+// A safety check: returns whether the state is safe and, if so, fills safeSeq with an order
+struct SafetyCheck {
+    const char *name;
+    bool (*isSafe)(struct Banker *b, int *safeSeq);
+};
+
+double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+long long nowNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void histRecord(struct Histogram *h, long long value) {
+    int index;
+
+    if (value < 2 * HIST_SUB_BUCKETS) {
+        index = value < 0 ? 0 : (int)value;
+    } else {
+        int shift = 63 - __builtin_clzll(value) - HIST_SUB_BITS;
+        index = (shift + 1) * HIST_SUB_BUCKETS + (int)(value >> shift) - HIST_SUB_BUCKETS;
+    }
+    h->buckets[index]++;
+    h->count++;
+    if (value > h->max) {
+        h->max = value;
+    }
+}
+
+// Upper bound of the bucket holding quantile q (0..1), capped at the largest value seen
+long long histQuantile(const struct Histogram *h, double q) {
+    long long rank = (long long)(q * h->count + 0.5);
+    long long seen = 0;
+
+    if (rank < 1) {
+        rank = 1;
+    }
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            if (i < 2 * HIST_SUB_BUCKETS) {
+                return i;
+            }
+            int shift = i / HIST_SUB_BUCKETS - 1;
+            long long upper = ((long long)(i % HIST_SUB_BUCKETS + HIST_SUB_BUCKETS + 1) << shift) - 1;
+            return upper < h->max ? upper : h->max;
+        }
+    }
+    return h->max;
+}
+
+// Add every bucket of src to dst
+void histMerge(struct Histogram *dst, const struct Histogram *src) {
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+    dst->count += src->count;
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+}
+
+static inline void futexWait(atomic_uint *addr, unsigned expected) {
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+static inline void futexWake(atomic_uint *addr, int count) {
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+int *allocRows(int rows, int stride) {
+    int *p = aligned_alloc(VECTOR_BYTES, (size_t)rows * stride * sizeof(int));
+
+    memset(p, 0, (size_t)rows * stride * sizeof(int));
+    return p;
+}
+
+struct Banker *bankerCreate(int n, int m) {
+    struct Banker *b = calloc(1, sizeof(struct Banker));
+
+    b->n = n;
+    b->m = m;
+    b->stride = (m + LANES - 1) / LANES * LANES;
+    b->max = allocRows(n, b->stride);
+    b->allot = allocRows(n, b->stride);
+    b->need = allocRows(n, b->stride);
+    b->avail = allocRows(1, b->stride);
+    b->work = allocRows(1, b->stride);
+    b->finish = malloc(n * sizeof(bool));
+    b->seq = malloc(n * sizeof(int));
+    b->seqPos = malloc(n * sizeof(int));
+    b->trySeq = malloc(n * sizeof(int));
+    b->touched = malloc(m * sizeof(int));
+    b->isTouched = calloc(m, sizeof(bool));
+    return b;
+}
+
+void bankerFree(struct Banker *b) {
+    free(b->max);
+    free(b->allot);
+    free(b->need);
+    free(b->avail);
+    free(b->work);
+    free(b->finish);
+    free(b->seq);
+    free(b->seqPos);
+    free(b->trySeq);
+    free(b->touched);
+    free(b->isTouched);
+    free(b->byNeed);
+    free(b->unsat);
+    free(b->next);
+    for (int i = 0; i < 2; i++) {
+        free(b->keys[i]);
+        free(b->ids[i]);
+    }
+    free(b);
+}
+
+// Function to calculate the need matrix
+void calculateNeed(struct Banker *b) {
+    for (long i = 0; i < (long)b->n * b->stride; i++) {
+        b->need[i] = b->max[i] - b->allot[i];
+    }
+}
+
+// The isSafe() of 9.c on runtime sizes: repeated passes over the unfinished processes
+bool isSafeScalar(struct Banker *b, int *safeSeq) {
+    int n = b->n, m = b->m, stride = b->stride;
+    int *work = b->work;
+
+    memset(b->finish, 0, n * sizeof(bool));
+    memcpy(work, b->avail, stride * sizeof(int)); // Initialize work with available resources
+
+    int count = 0; // Count of processes that have finished
+    while (count < n) {
+        bool found = false;
+        for (int p = 0; p < n; p++) {
+            if (b->finish[p]) {
+                continue;
+            }
+            const int *need = b->need + (long)p * stride;
+            int j;
+            for (j = 0; j < m; j++) {
+                if (need[j] > work[j]) {
+                    break; // Break if the needed resources are more than available
+                }
+            }
+            if (j == m) {
+                const int *allot = b->allot + (long)p * stride;
+                for (int k = 0; k < m; k++) {
+                    work[k] += allot[k]; // Add the allocated resources to work
+                }
+                safeSeq[count++] = p;
+                b->finish[p] = true;
+                found = true;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// need <= work in every resource: one compare per vector of resources. Like the scalar loop it
+// stops at the first vector with a resource short, which is usually the first one. That makes it
+// no faster than the scalar loop when almost every row is short of its first resource, as in the
+// -w worst case: both load one cache line per row, and the 8-lane AVX2 reduction costs more than
+// the scalar compare it replaces (measured at 10,000 x 64: 4.9 vs 4.9 checks/sec with -O2, 4.5 vs
+// 4.9 with -march=native). ORing every vector of the row and branching once is worse still, at
+// under a third of the scalar rate, since it always reads the whole row. Vectors win on states
+// where rows pass their first resources, such as the random ones (220 vs 116 checks/sec).
+static inline __attribute__((always_inline)) bool rowFits(const int *need, const int *work, int vectors) {
+    for (int v = 0; v < vectors; v++) {
+        VecWide over = (VecWide)(*(const VecInt *)(need + v * LANES) > *(const VecInt *)(work + v * LANES));
+#if LANES == 8
+        if (over[0] | over[1] | over[2] | over[3]) {
+#else
+        if (over[0] | over[1]) {
+#endif
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline __attribute__((always_inline)) void rowAdd(int *work, const int *allot, int vectors) {
+    for (int v = 0; v < vectors; v++) {
+        *(VecInt *)(work + v * LANES) += *(const VecInt *)(allot + v * LANES);
+    }
+}
+
+// The same passes with vector row operations. Called with a constant vectors from the
+// specialised wrappers below, where the compiler unrolls the per-row loops completely.
+static inline __attribute__((always_inline)) bool safeKernel(struct Banker *b, int *safeSeq, int vectors) {
+    int n = b->n, stride = b->stride;
+    int *work = b->work;
+
+    memset(b->finish, 0, n * sizeof(bool));
+    memcpy(work, b->avail, stride * sizeof(int));
+
+    int count = 0;
+    while (count < n) {
+        bool found = false;
+        for (int p = 0; p < n; p++) {
+            if (!b->finish[p] && rowFits(b->need + (long)p * stride, work, vectors)) {
+                rowAdd(work, b->allot + (long)p * stride, vectors);
+                safeSeq[count++] = p;
+                b->finish[p] = true;
+                found = true;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool isSafeVector8(struct Banker *b, int *safeSeq) {
+    return safeKernel(b, safeSeq, 8 / LANES);
+}
+
+bool isSafeVector16(struct Banker *b, int *safeSeq) {
+    return safeKernel(b, safeSeq, 16 / LANES);
+}
+
+bool isSafeVector32(struct Banker *b, int *safeSeq) {
+    return safeKernel(b, safeSeq, 32 / LANES);
+}
+
+bool isSafeVector64(struct Banker *b, int *safeSeq) {
+    return safeKernel(b, safeSeq, 64 / LANES);
+}
+
+bool isSafeVectorAny(struct Banker *b, int *safeSeq) {
+    return safeKernel(b, safeSeq, b->stride / LANES);
+}
+
+// Pick the kernel specialised for this many resources, if there is one
+bool isSafeVector(struct Banker *b, int *safeSeq) {
+    switch (b->stride) {
+    case 8:
+        return isSafeVector8(b, safeSeq);
+    case 16:
+        return isSafeVector16(b, safeSeq);
+    case 32:
+        return isSafeVector32(b, safeSeq);
+    case 64:
+        return isSafeVector64(b, safeSeq);
+    default:
+        return isSafeVectorAny(b, safeSeq);
+    }
+}
+
+// Sort the processes by their need of resource j, which byNeed holds column j of need in, into
+// that column. LSD radix sort on the bytes of the need, skipping bytes that are the same for
+// every process, which for small needs is all but one.
+void sortByNeed(struct Banker *b, int j) {
+    int n = b->n;
+    int *column = b->byNeed + (long)j * n;
+    unsigned *keys = b->keys[0], *keysOut = b->keys[1];
+    int *ids = b->ids[0], *idsOut = b->ids[1];
+
+    for (int p = 0; p < n; p++) {
+        keys[p] = (unsigned)column[p] ^ 0x80000000u; // Negative needs sort first
+        ids[p] = p;
+    }
+    for (int shift = 0; shift < 32; shift += 8) {
+        int count[257] = {0};
+        for (int i = 0; i < n; i++) {
+            count[((keys[i] >> shift) & 0xff) + 1]++;
+        }
+        if (count[((keys[0] >> shift) & 0xff) + 1] == n) {
+            continue;
+        }
+        for (int d = 0; d < 256; d++) {
+            count[d + 1] += count[d];
+        }
+        for (int i = 0; i < n; i++) {
+            int pos = count[(keys[i] >> shift) & 0xff]++;
+            keysOut[pos] = keys[i];
+            idsOut[pos] = ids[i];
+        }
+        unsigned *tk = keys;
+        keys = keysOut;
+        keysOut = tk;
+        int *ti = ids;
+        ids = idsOut;
+        idsOut = ti;
+    }
+    memcpy(column, ids, n * sizeof(int));
+}
+
+// Move resource j's cursor past every process whose need of j now fits in work. A process whose
+// last unsatisfied resource this was can finish, so it joins the end of the worklist.
+static inline void satisfy(struct Banker *b, int j, int *safeSeq, int *tail) {
+    const int *order = b->byNeed + (long)j * b->n;
+    int k = b->next[j];
+
+    while (k < b->n && b->need[(long)order[k] * b->stride + j] <= b->work[j]) {
+        if (--b->unsat[order[k]] == 0) {
+            safeSeq[(*tail)++] = order[k];
+        }
+        k++;
+    }
+    b->next[j] = k;
+}
+
+// Worklist safety check in O(n·m) after sorting: instead of rescanning every unfinished process
+// until nothing changes, keep each resource's processes in order of need and count the
+// resources each process is still short of. safeSeq doubles as the worklist, since a process
+// joins it exactly when it can finish, and work only grows from there.
+bool isSafeWorklist(struct Banker *b, int *safeSeq) {
+    int n = b->n, m = b->m, stride = b->stride;
+
+    if (!b->byNeed) {
+        b->byNeed = malloc((size_t)m * n * sizeof(int));
+        b->unsat = malloc(n * sizeof(int));
+        b->next = malloc(m * sizeof(int));
+        for (int i = 0; i < 2; i++) {
+            b->keys[i] = malloc(n * sizeof(unsigned));
+            b->ids[i] = malloc(n * sizeof(int));
+        }
+    }
+    memcpy(b->work, b->avail, stride * sizeof(int));
+    for (int p = 0; p < n; p++) {
+        b->unsat[p] = m;
+    }
+
+    // Transpose need into byNeed in one pass over the rows, so each sort reads a contiguous column
+    for (int p = 0; p < n; p++) {
+        const int *need = b->need + (long)p * stride;
+        for (int j = 0; j < m; j++) {
+            b->byNeed[(long)j * n + p] = need[j];
+        }
+    }
+
+    int head = 0, tail = 0;
+    for (int j = 0; j < m; j++) {
+        sortByNeed(b, j);
+        b->next[j] = 0;
+        satisfy(b, j, safeSeq, &tail);
+    }
+    while (head < tail) {
+        const int *allot = b->allot + (long)safeSeq[head++] * stride;
+        for (int j = 0; j < m; j++) {
+            if (allot[j] != 0) {
+                b->work[j] += allot[j];
+                satisfy(b, j, safeSeq, &tail);
+            }
+        }
+    }
+    return tail == n;
+}
+
+const struct SafetyCheck checks[] = {
+    {"scalar", isSafeScalar},
+    {"vector", isSafeVector},
+    {"worklist", isSafeWorklist},
+};
+const int checkCount = sizeof(checks) / sizeof(checks[0]);
+
+// Move amount from available to process p's allocation (sign 1) or back again (sign -1). max
+// stays the same, so need moves the other way.
+void applyRequest(struct Banker *b, int p, const int *amount, int sign) {
+    int *allot = b->allot + (long)p * b->stride;
+    int *need = b->need + (long)p * b->stride;
+
+    for (int j = 0; j < b->m; j++) {
+        b->avail[j] -= sign * amount[j];
+        allot[j] += sign * amount[j];
+        need[j] -= sign * amount[j];
+    }
+}
+
+// Add the resources amount asks for to the touched list
+void touchResources(struct Banker *b, const int *amount) {
+    for (int j = 0; j < b->m; j++) {
+        if (amount[j] != 0 && !b->isTouched[j]) {
+            b->isTouched[j] = true;
+            b->touched[b->touchedCount++] = j;
+        }
+    }
+}
+
+void clearTouched(struct Banker *b) {
+    for (int t = 0; t < b->touchedCount; t++) {
+        b->isTouched[b->touched[t]] = false;
+    }
+    b->touchedCount = 0;
+}
+
+// Whether seq is still safe after requests of the touched resources were granted to processes
+// no later than position upTo in seq. Once those have finished, work is what it was before the
+// requests, so only that prefix of seq needs checking, and only in the touched resources.
+bool prefixStillSafe(struct Banker *b, int upTo) {
+    int stride = b->stride;
+
+    for (int t = 0; t < b->touchedCount; t++) {
+        b->work[b->touched[t]] = b->avail[b->touched[t]];
+    }
+    for (int i = 0; i <= upTo; i++) {
+        const int *need = b->need + (long)b->seq[i] * stride;
+        const int *allot = b->allot + (long)b->seq[i] * stride;
+        for (int t = 0; t < b->touchedCount; t++) {
+            int j = b->touched[t];
+            if (need[j] > b->work[j]) {
+                return false;
+            }
+            b->work[j] += allot[j];
+        }
+    }
+    return true;
+}
+
+// Run isSafe() on the current state and, if it is safe, keep the sequence it found
+bool checkAndKeepSequence(struct Banker *b) {
+    b->fullChecks++;
+    if (!isSafeVector(b, b->trySeq)) {
+        return false;
+    }
+    int *t = b->seq;
+    b->seq = b->trySeq;
+    b->trySeq = t;
+    for (int i = 0; i < b->n; i++) {
+        b->seqPos[b->seq[i]] = i;
+    }
+    b->seqValid = true;
+    return true;
+}
+
+// The resource-request algorithm: grant process p's request only if the state stays safe.
+// Returns 1 if granted, 0 if it was refused because the state would be unsafe, and -1 if it asks
+// for a negative amount, more than p still needs or more than is available. incremental tries the last safe
+// sequence first and only runs isSafe() when that fails, otherwise every request runs it.
+int bankerRequest(struct Banker *b, int p, const int *request, bool incremental) {
+    const int *need = b->need + (long)p * b->stride;
+
+    for (int j = 0; j < b->m; j++) {
+        if (request[j] < 0 || request[j] > need[j] || request[j] > b->avail[j]) {
+            return -1;
+        }
+    }
+    applyRequest(b, p, request, 1);
+
+    clearTouched(b);
+    touchResources(b, request);
+    if (incremental && b->seqValid && prefixStillSafe(b, b->seqPos[p])) {
+        b->fastPath++;
+        return 1;
+    }
+    if (!checkAndKeepSequence(b)) {
+        applyRequest(b, p, request, -1); // Roll back; the old sequence holds again
+        return 0;
+    }
+    return 1;
+}
+
+// Process p gives back resources it holds. Always safe: work before p finishes is higher by
+// release and p's need by the same amount, and after p it is what it was, so seq still holds.
+int bankerRelease(struct Banker *b, int p, const int *release) {
+    const int *allot = b->allot + (long)p * b->stride;
+
+    for (int j = 0; j < b->m; j++) {
+        if (release[j] < 0 || release[j] > allot[j]) {
+            return -1;
+        }
+    }
+    applyRequest(b, p, release, -1);
+    return 1;
+}
+
+// Replay a safe sequence step by step; true if every process really could finish in that order
+bool validSequence(const struct Banker *b, const int *safeSeq) {
+    int *work = malloc(b->stride * sizeof(int));
+    bool *seen = calloc(b->n, sizeof(bool));
+    bool ok = true;
+
+    memcpy(work, b->avail, b->stride * sizeof(int));
+    for (int i = 0; i < b->n && ok; i++) {
+        int p = safeSeq[i];
+        if (p < 0 || p >= b->n || seen[p]) {
+            ok = false;
+            break;
+        }
+        seen[p] = true;
+        for (int j = 0; j < b->m; j++) {
+            if (b->need[(long)p * b->stride + j] > work[j]) {
+                ok = false;
+            }
+            work[j] += b->allot[(long)p * b->stride + j];
+        }
+    }
+    free(work);
+    free(seen);
+    return ok;
+}
+
+// A random safe state: walk the processes in a random order and give each one a need that the
+// resources released by the processes before it can cover. An unsafe state is made from it by
+// having the last two processes in that order each need one unit more of a resource than the
+// others release, which only the other one of the two can supply. Every maximum stays within
+// the resources that exist, so the state is one the request algorithm could have reached.
+void randomState(struct Banker *b, unsigned seed, bool safe) {
+    int *order = malloc(b->n * sizeof(int));
+    long *work = calloc(b->m, sizeof(long));
+
+    srand(seed);
+    for (int i = 0; i < b->n; i++) {
+        order[i] = i;
+    }
+    for (int i = b->n - 1; i > 0; i--) {
+        int k = rand() % (i + 1);
+        int t = order[i];
+        order[i] = order[k];
+        order[k] = t;
+    }
+    for (int j = 0; j < b->m; j++) {
+        b->avail[j] = rand() % 10;
+        work[j] = b->avail[j];
+    }
+    for (int i = 0; i < b->n; i++) {
+        int p = order[i];
+        for (int j = 0; j < b->m; j++) {
+            long bound = work[j] < 1000 ? work[j] : 1000;
+            b->allot[(long)p * b->stride + j] = rand() % 10;
+            b->max[(long)p * b->stride + j] = b->allot[(long)p * b->stride + j] + (int)(rand() % (bound + 1));
+            work[j] += b->allot[(long)p * b->stride + j];
+        }
+    }
+    if (!safe) {
+        int j = rand() % b->m;
+        int *a1 = &b->allot[(long)order[b->n - 2] * b->stride + j];
+        int *a2 = &b->allot[(long)order[b->n - 1] * b->stride + j];
+        long others = work[j] - *a1 - *a2; // What is free once everyone else has finished
+        if (*a1 == 0) {
+            *a1 = 1;
+        }
+        if (*a2 == 0) {
+            *a2 = 1;
+        }
+        b->max[(long)order[b->n - 2] * b->stride + j] = *a1 + (int)others + 1;
+        b->max[(long)order[b->n - 1] * b->stride + j] = *a2 + (int)others + 1;
+    }
+    free(order);
+    free(work);
+}
+
+// The worst case for repeated passes: process p can only finish once every process after it
+// has, and each one needs exactly what those before it in that order released, so every pass
+// over the processes from 0 upwards finishes only the last one still waiting. Unsafe, process 1
+// needs one unit more, which only process 0, the one after it, holds.
+void chainState(struct Banker *b, bool safe) {
+    for (int j = 0; j < b->m; j++) {
+        b->avail[j] = 1;
+    }
+    for (int p = 0; p < b->n; p++) {
+        for (int j = 0; j < b->m; j++) {
+            b->allot[(long)p * b->stride + j] = 1;
+            b->max[(long)p * b->stride + j] = 1 + (b->n - p); // need = 1 + processes finished before it
+        }
+    }
+    if (!safe) {
+        b->max[b->stride] = b->n + 1;
+    }
+}
+
+void buildState(struct Banker *b, bool worstCase, bool safe, unsigned seed) {
+    if (worstCase) {
+        chainState(b, safe);
+    } else {
+        randomState(b, seed, safe);
+    }
+    calculateNeed(b);
+    b->seqValid = false;
+    b->fastPath = 0;
+    b->fullChecks = 0;
+}
+
+struct StreamResult {
+    long granted;
+    long unsafe;  // Refused to keep the state safe
+    long invalid; // More than needed or available, or nothing at all
+    long releases;
+    unsigned long long decisions; // Hash of the outcome of every operation, in order
+    double seconds;
+};
+
+// Three random requests of 1 to 4 resource types to every release of part of an allocation
+void requestStream(struct Banker *b, long operations, unsigned seed, bool incremental, struct StreamResult *r) {
+    int *amount = malloc(b->m * sizeof(int));
+
+    memset(r, 0, sizeof(*r));
+    r->decisions = 0xcbf29ce484222325ull; // FNV-1a offset basis
+    srand(seed);
+    double start = nowSeconds();
+    for (long op = 0; op < operations; op++) {
+        int p = rand() % b->n;
+        bool release = rand() % 4 == 0;
+        int kinds = 1 + rand() % 4;
+        bool any = false;
+
+        memset(amount, 0, b->m * sizeof(int));
+        for (int k = 0; k < kinds; k++) {
+            int j = rand() % b->m;
+            long idx = (long)p * b->stride + j;
+            int limit = release ? b->allot[idx] : (b->need[idx] < b->avail[j] ? b->need[idx] : b->avail[j]);
+            if (limit > 0) {
+                amount[j] = release ? 1 + rand() % limit : 1; // Hand out one unit at a time
+                any = true;
+            }
+        }
+        int outcome = -1;
+        if (!any) {
+            r->invalid++;
+        } else if (release) {
+            outcome = 2 + bankerRelease(b, p, amount);
+            r->releases++;
+        } else {
+            outcome = bankerRequest(b, p, amount, incremental);
+            if (outcome == 1) {
+                r->granted++;
+            } else if (outcome == 0) {
+                r->unsafe++;
+            } else {
+                r->invalid++;
+            }
+        }
+        r->decisions = (r->decisions ^ (unsigned)(outcome + 2)) * 0x100000001B3ull; // FNV-1a step
+    }
+    r->seconds = nowSeconds() - start;
+    free(amount);
+}
+
+// The allocator service: client threads send requests and releases to one allocator thread
+// through a lock-free stack and sleep on a futex until their request is granted. The allocator
+// takes everything sent since it last looked, applies releases at once and then admits waiting
+// requests in arrival order as a batch: as long a prefix as is available, cut down by binary
+// search to the longest prefix that leaves the state safe. Granting fewer requests is the same
+// as releasing the rest, which never makes a safe state unsafe, so whether a prefix is safe is
+// monotone in its length. Requests past the cut are then tried one at a time, so a request that
+// cannot go ahead does not hold up one that can. Granting requests never lets a deferred one
+// in, so the deferred requests are only looked at again after a release.
+//
+// Left at that, later requests can overtake a deferred one for ever: clients that finish start
+// over and take the resources it is waiting for again. Once a request has been passed over in
+// STARVE_ROUNDS rounds the allocator holds the others back: a process that gives back everything
+// it holds while such a request waits is frozen, and its requests wait too. Frozen processes hold
+// nothing, so dropping them from a safe sequence leaves it safe and the first unfrozen process in
+// it can always finish. Every unfrozen process finishes at most once before it freezes, so the
+// starved request's process eventually needs no more than is available and is granted. Then
+// every process is unfrozen again.
+struct ServiceOp {
+    struct ServiceOp *next;
+    int process;
+    bool release;
+    int *amount;
+    long long sent;    // nowNanos() when the client sent it
+    int deferrals;     // Admission rounds it has been passed over in
+    atomic_uint state; // OP_PENDING until the allocator has applied or granted it
+    atomic_uint sleeping;
+};
+
+struct Service {
+    struct Banker *b;
+    _Alignas(CACHE_LINE) _Atomic(struct ServiceOp *) incoming; // Stack of ops not yet seen, newest first
+    _Alignas(CACHE_LINE) atomic_uint signal;                   // Bumped on every send, the allocator sleeps on it
+    atomic_uint allocatorSleeping;
+    atomic_int activeClients;
+    atomic_int stop;
+    struct ServiceOp **waiting; // Requests not granted yet, oldest first
+    int waitingCount;
+    bool holding; // A request has starved: frozen processes are not admitted
+    bool *frozen; // Gave back everything while holding, one per process
+    long granted;
+    long deferred; // Times a request was left waiting after an admission round
+    long holds;    // Times a starved request made the allocator hold others back
+    int maxDeferrals;
+    long releases;
+    long batches;
+    long checks;
+};
+
+struct ClientArgs {
+    struct Service *s;
+    int process;
+    unsigned seed;
+    struct ServiceOp op; // Outlives the thread, since the allocator may still wake it after the last op
+    struct Histogram admission; // Time from sending a request until it was granted
+};
+
+static inline void opDone(struct ServiceOp *op) {
+    atomic_store(&op->state, OP_DONE);
+    if (atomic_load(&op->sleeping)) {
+        futexWake(&op->state, 1);
+    }
+}
+
+// Send op to the allocator and wait until it has been applied or granted
+void serviceSend(struct Service *s, struct ServiceOp *op) {
+    op->sent = nowNanos();
+    op->deferrals = 0;
+    atomic_store_explicit(&op->state, OP_PENDING, memory_order_relaxed);
+    op->next = atomic_load_explicit(&s->incoming, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&s->incoming, &op->next, op, memory_order_release,
+                                                  memory_order_relaxed)) {
+    }
+    atomic_fetch_add(&s->signal, 1); // Sequentially consistent, pairs with the allocator's sleeping flag
+    if (atomic_load(&s->allocatorSleeping)) {
+        futexWake(&s->signal, 1);
+    }
+
+    for (int spins = 0; atomic_load(&op->state) == OP_PENDING;) {
+        if (++spins < SPIN_LIMIT) {
+            cpuRelax();
+            continue;
+        }
+        atomic_store(&op->sleeping, 1);
+        if (atomic_load(&op->state) == OP_PENDING) {
+            futexWait(&op->state, OP_PENDING);
+        }
+        atomic_store(&op->sleeping, 0);
+    }
+}
+
+static bool fitsAvailable(const struct Banker *b, const int *amount) {
+    for (int j = 0; j < b->m; j++) {
+        if (amount[j] > b->avail[j]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Apply or undo the requests in batch until the first count of them are granted
+static void applyWaiting(struct ServiceOp **batch, struct Banker *b, int *applied, int count) {
+    for (; *applied < count; (*applied)++) {
+        applyRequest(b, batch[*applied]->process, batch[*applied]->amount, 1);
+    }
+    for (; *applied > count; (*applied)--) {
+        applyRequest(b, batch[*applied - 1]->process, batch[*applied - 1]->amount, -1);
+    }
+}
+
+// Whether the state is still safe with ops granted on top of a state that seq is safe for: the
+// prefix of seq up to the last of their processes first, isSafe() if that fails. When it is
+// safe, seq is a safe sequence for the new state either way.
+static bool requestsSafe(struct Service *s, struct ServiceOp **ops, int count) {
+    struct Banker *b = s->b;
+    int upTo = -1;
+
+    s->checks++;
+    clearTouched(b);
+    for (int i = 0; i < count; i++) {
+        touchResources(b, ops[i]->amount);
+        if (b->seqPos[ops[i]->process] > upTo) {
+            upTo = b->seqPos[ops[i]->process];
+        }
+    }
+    if (prefixStillSafe(b, upTo)) {
+        b->fastPath++;
+        return true;
+    }
+    return checkAndKeepSequence(b);
+}
+
+static inline bool heldBack(const struct Service *s, const struct ServiceOp *op) {
+    return s->holding && s->frozen[op->process];
+}
+
+// Start or end holding back requests once every waiting request has been looked at
+void updateHolding(struct Service *s) {
+    bool starved = false;
+
+    for (int i = 0; i < s->waitingCount; i++) {
+        if (!s->frozen[s->waiting[i]->process] && s->waiting[i]->deferrals >= STARVE_ROUNDS) {
+            starved = true;
+        }
+    }
+    if (starved && !s->holding) {
+        s->holds++;
+    }
+    if (!starved && s->holding) {
+        // The frozen processes' requests were waiting on purpose; they start counting again
+        for (int i = 0; i < s->waitingCount; i++) {
+            if (s->frozen[s->waiting[i]->process]) {
+                s->waiting[i]->deferrals = 0;
+            }
+        }
+        memset(s->frozen, 0, s->b->n * sizeof(bool));
+    }
+    s->holding = starved;
+}
+
+// One admission round over the waiting requests from first on
+void admitWaiting(struct Service *s, int first) {
+    struct Banker *b = s->b;
+    struct ServiceOp **batch = s->waiting + first;
+    int count = s->waitingCount - first;
+    int applied = 0;
+
+    s->batches++;
+    // The longest prefix that fits in what is available; clients never ask for more than they need
+    while (applied < count && !heldBack(s, batch[applied]) && fitsAvailable(b, batch[applied]->amount)) {
+        applyRequest(b, batch[applied]->process, batch[applied]->amount, 1);
+        applied++;
+    }
+
+    // seq is safe for the state with the first lo requests granted, and hi is the shortest
+    // prefix known to be unsafe
+    int lo = applied, hi = applied + 1;
+    int blocked = -1; // The request that made the granted prefix unsafe
+    if (applied > 0 && !requestsSafe(s, batch, applied)) {
+        lo = 0;
+        hi = applied;
+        while (hi - lo > 1) {
+            int mid = (lo + hi) / 2;
+            applyWaiting(batch, b, &applied, mid);
+            if (requestsSafe(s, batch + lo, mid - lo)) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        applyWaiting(batch, b, &applied, lo);
+        blocked = lo;
+    }
+    for (int i = 0; i < lo; i++) {
+        opDone(batch[i]);
+    }
+    s->granted += lo;
+
+    // The rest one at a time, keeping the ones that still cannot go in order
+    int kept = 0;
+    for (int i = lo; i < count; i++) {
+        struct ServiceOp *op = batch[i];
+        if (i != blocked && !heldBack(s, op) && fitsAvailable(b, op->amount)) {
+            applyRequest(b, op->process, op->amount, 1);
+            if (requestsSafe(s, &op, 1)) {
+                opDone(op);
+                s->granted++;
+                continue;
+            }
+            applyRequest(b, op->process, op->amount, -1);
+        }
+        if (!heldBack(s, op) && ++op->deferrals > s->maxDeferrals) {
+            s->maxDeferrals = op->deferrals;
+        }
+        batch[kept++] = op;
+    }
+    s->waitingCount = first + kept;
+    s->deferred += kept;
+    updateHolding(s);
+}
+
+bool holdsNothing(const struct Banker *b, int p) {
+    for (int j = 0; j < b->m; j++) {
+        if (b->allot[(long)p * b->stride + j] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void *allocatorThread(void *arg) {
+    struct Service *s = arg;
+    bool released = false; // Something was given back, so deferred requests may fit now
+
+    while (atomic_load(&s->activeClients) > 0 || s->waitingCount > 0) {
+        unsigned seen = atomic_load(&s->signal);
+        struct ServiceOp *ops = atomic_exchange_explicit(&s->incoming, NULL, memory_order_acquire);
+
+        if (ops == NULL) {
+            atomic_store(&s->allocatorSleeping, 1);
+            if (atomic_load(&s->signal) == seen) {
+                futexWait(&s->signal, seen);
+            }
+            atomic_store(&s->allocatorSleeping, 0);
+            continue;
+        }
+
+        // The stack is newest first: reverse it so requests queue up in the order they were sent
+        struct ServiceOp *fifo = NULL;
+        while (ops != NULL) {
+            struct ServiceOp *next = ops->next;
+            ops->next = fifo;
+            fifo = ops;
+            ops = next;
+        }
+        int deferred = s->waitingCount;
+        for (struct ServiceOp *op = fifo, *next; op != NULL; op = next) {
+            next = op->next; // op belongs to its client again once it is done
+            if (op->release) {
+                bankerRelease(s->b, op->process, op->amount);
+                if (s->holding && holdsNothing(s->b, op->process)) {
+                    s->frozen[op->process] = true; // Finished: it must not take anything again yet
+                }
+                s->releases++;
+                released = true;
+                opDone(op);
+            } else {
+                s->waiting[s->waitingCount++] = op;
+            }
+        }
+        int first = released ? 0 : deferred;
+        if (first < s->waitingCount) {
+            admitWaiting(s, first);
+        }
+        released = false;
+    }
+    return NULL;
+}
+
+// A client runs one process: it asks for one unit at a time of a resource it still needs,
+// sometimes gives one back, and when its need is met it finishes, releases everything and
+// starts over with the same maximum
+void *clientThread(void *arg) {
+    struct ClientArgs *args = arg;
+    struct Service *s = args->s;
+    struct Banker *b = s->b;
+    int m = b->m;
+    int *max = malloc(m * sizeof(int));
+    int *allot = malloc(m * sizeof(int));
+    struct ServiceOp *op = &args->op;
+
+    op->process = args->process;
+    op->amount = calloc(m, sizeof(int));
+
+    memcpy(max, b->max + (long)args->process * b->stride, m * sizeof(int));
+    memcpy(allot, b->allot + (long)args->process * b->stride, m * sizeof(int));
+
+    while (!atomic_load_explicit(&s->stop, memory_order_relaxed)) {
+        int j = rand_r(&args->seed) % m;
+        int k;
+        for (k = 0; k < m && allot[(j + k) % m] == max[(j + k) % m]; k++) {
+        }
+        memset(op->amount, 0, m * sizeof(int));
+        if (k == m) {
+            memcpy(op->amount, allot, m * sizeof(int)); // Finished: give everything back
+            op->release = true;
+            serviceSend(s, op);
+            memset(allot, 0, m * sizeof(int));
+            continue;
+        }
+        j = (j + k) % m;
+        op->amount[j] = 1;
+        op->release = false;
+        serviceSend(s, op);
+        histRecord(&args->admission, nowNanos() - op->sent);
+        allot[j]++;
+
+        if (rand_r(&args->seed) % 4 == 0) {
+            memset(op->amount, 0, m * sizeof(int));
+            op->amount[j] = 1;
+            op->release = true;
+            serviceSend(s, op);
+            allot[j]--;
+        }
+    }
+    memcpy(op->amount, allot, m * sizeof(int)); // Leave nothing held
+    op->release = true;
+    serviceSend(s, op);
+
+    atomic_fetch_sub(&s->activeClients, 1);
+    atomic_fetch_add(&s->signal, 1);
+    if (atomic_load(&s->allocatorSleeping)) {
+        futexWake(&s->signal, 1);
+    }
+    free(max);
+    free(allot);
+    free(op->amount);
+    return NULL;
+}
+
+// Run one client per process of b for the given time and report admission latency and throughput
+void runService(struct Banker *b, double seconds, unsigned seed) {
+    struct Service *s = calloc(1, sizeof(struct Service));
+    struct ClientArgs *args = calloc(b->n, sizeof(struct ClientArgs));
+    pthread_t *clients = malloc(b->n * sizeof(pthread_t));
+    pthread_t allocator;
+    struct Histogram *admission = calloc(1, sizeof(struct Histogram));
+
+    s->b = b;
+    s->waiting = malloc(b->n * sizeof(struct ServiceOp *));
+    s->frozen = calloc(b->n, sizeof(bool));
+    atomic_store(&s->activeClients, b->n);
+    if (!checkAndKeepSequence(b)) {
+        fprintf(stderr, "The starting state is not safe\n");
+        exit(1);
+    }
+    b->fullChecks = 0;
+
+    double start = nowSeconds();
+    pthread_create(&allocator, NULL, allocatorThread, s);
+    for (int i = 0; i < b->n; i++) {
+        args[i].s = s;
+        args[i].process = i;
+        args[i].seed = seed + i;
+        pthread_create(&clients[i], NULL, clientThread, &args[i]);
+    }
+    usleep((useconds_t)(seconds * 1e6));
+    atomic_store(&s->stop, 1);
+    for (int i = 0; i < b->n; i++) {
+        pthread_join(clients[i], NULL);
+        histMerge(admission, &args[i].admission);
+    }
+    pthread_join(allocator, NULL);
+    double elapsed = nowSeconds() - start;
+
+    printf("%d clients x %d resources, %.1f seconds\n\n", b->n, b->m, elapsed);
+    printf("Granted\t\tReleases\tDeferred\tBatches\tChecks\tFast path\tGrants/sec\tOps/sec\n");
+    printf("%ld\t\t%ld\t\t%ld\t\t%ld\t%ld\t%ld\t\t%.1f\t%.1f\n", s->granted, s->releases, s->deferred, s->batches,
+           s->checks, b->fastPath, s->granted / elapsed, (s->granted + s->releases) / elapsed);
+    printf("\nMost admission rounds a request was passed over in: %d; others held back %ld times\n",
+           s->maxDeferrals, s->holds);
+    printf("Admission latency (us): p50 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n", histQuantile(admission, 0.5) / 1e3,
+           histQuantile(admission, 0.99) / 1e3, histQuantile(admission, 0.999) / 1e3, admission->max / 1e3);
+    if (!validSequence(b, b->seq)) {
+        fprintf(stderr, "The allocator left the state without a valid safe sequence\n");
+    }
+
+    free(s->waiting);
+    free(s->frozen);
+    free(s);
+    free(args);
+    free(clients);
+    free(admission);
+}
+
+// Time calculateNeed() and every safety check from 5 processes x 3 resources, the size of 9.c,
+// up to 100,000 x 256 on a safe and an unsafe state of each size, and check they all agree
+void sizeSweep(unsigned seed) {
+    static const int sizes[][2] = {{5, 3}, {100, 8}, {1000, 16}, {10000, 64}, {100000, 256}};
+
+    printf("Microseconds per call\n\n%-10s %-10s %-7s %14s", "Processes", "Resources", "State", "calculateNeed");
+    for (int c = 0; c < checkCount; c++) {
+        printf(" %14s", checks[c].name);
+    }
+    printf("\n");
+
+    for (int i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+        struct Banker *b = bankerCreate(sizes[i][0], sizes[i][1]);
+        int *safeSeq = malloc(b->n * sizeof(int));
+
+        for (int safe = 1; safe >= 0; safe--) {
+            buildState(b, false, safe, seed);
+            printf("%-10d %-10d %-7s", b->n, b->m, safe ? "safe" : "unsafe");
+
+            // Repeat each call until it has run for at least 0.1 s
+            long calls = 0;
+            double start = nowSeconds(), elapsed;
+            do {
+                calculateNeed(b);
+                calls++;
+            } while ((elapsed = nowSeconds() - start) < 0.1);
+            printf(" %14.3f", elapsed / calls * 1e6);
+
+            for (int c = 0; c < checkCount; c++) {
+                bool result;
+                calls = 0;
+                start = nowSeconds();
+                do {
+                    result = checks[c].isSafe(b, safeSeq);
+                    calls++;
+                } while ((elapsed = nowSeconds() - start) < 0.1);
+                printf(" %14.3f", elapsed / calls * 1e6);
+
+                if (result != safe) {
+                    fprintf(stderr, "\n%s: says a %s state is %s\n", checks[c].name, safe ? "safe" : "unsafe",
+                            result ? "safe" : "unsafe");
+                } else if (result && !validSequence(b, safeSeq)) {
+                    fprintf(stderr, "\n%s: returned an invalid safe sequence\n", checks[c].name);
+                }
+            }
+            printf("\n");
+        }
+        bankerFree(b);
+        free(safeSeq);
+    }
+}
+
+// 9.c's input order: available resources, then max and allot row by row
+int readState(struct Banker *b) {
+    for (int j = 0; j < b->m; j++) {
+        if (scanf("%d", &b->avail[j]) != 1) return 0;
+    }
+    for (int i = 0; i < b->n; i++) {
+        for (int j = 0; j < b->m; j++) {
+            if (scanf("%d", &b->max[(long)i * b->stride + j]) != 1) return 0;
+        }
+    }
+    for (int i = 0; i < b->n; i++) {
+        for (int j = 0; j < b->m; j++) {
+            if (scanf("%d", &b->allot[(long)i * b->stride + j]) != 1) return 0;
+        }
+    }
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    int n = 10000, m = 64;
+    int nSet = 0, mSet = 0;
+    int rounds = 20;
+    unsigned seed = 1;
+    int readInput = 0;
+    int worstCase = 0;
+    bool safe = true;
+    int sweep = 0;
+    long requests = 0;
+    int clients = 0;
+    double seconds = 2;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:m:k:s:wuGr:c:t:i")) != -1) {
+        switch (opt) {
+        case 'n':
+            n = atoi(optarg);
+            nSet = 1;
+            break;
+        case 'm':
+            m = atoi(optarg);
+            mSet = 1;
+            break;
+        case 'k':
+            rounds = atoi(optarg);
+            break;
+        case 's':
+            seed = (unsigned)atol(optarg);
+            break;
+        case 'w':
+            worstCase = 1;
+            break;
+        case 'u':
+            safe = false;
+            break;
+        case 'G':
+            sweep = 1;
+            break;
+        case 'r':
+            requests = atol(optarg);
+            break;
+        case 'c':
+            clients = atoi(optarg);
+            break;
+        case 't':
+            seconds = atof(optarg);
+            break;
+        case 'i':
+            readInput = 1;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n processes] [-m resources] [-k checks] [-s seed] [-w] [-u] [-G] [-r requests] [-c clients] [-t seconds] [-i]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (readInput) {
+        n = nSet ? n : 5;
+        m = mSet ? m : 3;
+    } else if (clients > 0) {
+        n = clients; // A process the clients do not run would never finish and release
+        m = mSet ? m : 8;
+    }
+    if (n <= 0 || m <= 0 || rounds <= 0) {
+        fprintf(stderr, "Processes, resources and checks must be positive\n");
+        return 1;
+    }
+    if (!safe && n < 2) {
+        fprintf(stderr, "An unsafe state needs at least 2 processes\n");
+        return 1;
+    }
+    if (sweep) {
+        sizeSweep(seed);
+        return 0;
+    }
+
+    struct Banker *b = bankerCreate(n, m);
+    int *safeSeq = malloc(n * sizeof(int));
+
+    if (readInput) {
+        if (!readState(b)) {
+            fprintf(stderr, "Expected %d available, then %d x %d max and allot values\n", m, n, m);
+            return 1;
+        }
+        calculateNeed(b);
+        if (isSafeVector(b, safeSeq)) {
+            printf("System is in a safe state.\nSafe sequence is: ");
+            for (int i = 0; i < n; i++) {
+                printf("%d ", safeSeq[i]);
+            }
+            printf("\n");
+        } else {
+            printf("System is not in a safe state.\n");
+        }
+        bankerFree(b);
+        free(safeSeq);
+        return 0;
+    }
+
+    buildState(b, worstCase, safe, seed);
+    if (clients > 0) {
+        runService(b, seconds, seed);
+        bankerFree(b);
+        free(safeSeq);
+        return 0;
+    }
+    printf("%d processes x %d resources (rows padded to %d), %d checks per variant\n\n", n, m, b->stride, rounds);
+    printf("Variant\t\tSafe\tSeconds\t\tChecks/sec\n");
+
+    int expected = -1;
+    for (int c = 0; c < checkCount; c++) {
+        bool safe = false;
+        double start = nowSeconds();
+        for (int r = 0; r < rounds; r++) {
+            safe = checks[c].isSafe(b, safeSeq);
+        }
+        double elapsed = nowSeconds() - start;
+
+        if (safe && !validSequence(b, safeSeq)) {
+            fprintf(stderr, "%s: returned an invalid safe sequence\n", checks[c].name);
+        }
+        if (expected >= 0 && safe != expected) {
+            fprintf(stderr, "%s: disagrees with %s on whether the state is safe\n", checks[c].name, checks[0].name);
+        }
+        expected = safe;
+        printf("%-8s\t%s\t%.4f\t\t%.1f\n", checks[c].name, safe ? "yes" : "no", elapsed, rounds / elapsed);
+    }
+
+    if (requests > 0) {
+        struct StreamResult results[2];
+
+        printf("\n%ld random requests and releases\n\n", requests);
+        printf("Check		Granted	Unsafe	Invalid	Releases	Fast path	Full checks	Requests/sec\n");
+        for (int incremental = 0; incremental < 2; incremental++) {
+            struct StreamResult *r = &results[incremental];
+            buildState(b, worstCase, safe, seed);
+            requestStream(b, requests, seed, incremental, r);
+            printf("%-11s\t%ld\t%ld\t%ld\t%ld\t\t%ld\t\t%ld\t\t%.1f\n", incremental ? "incremental" : "full",
+                   r->granted, r->unsafe, r->invalid, r->releases, b->fastPath, b->fullChecks,
+                   (r->granted + r->unsafe) / r->seconds); // Invalid requests never reach a check
+        }
+        // The same seeded stream: any request decided differently changes the hash
+        if (results[0].decisions != results[1].decisions) {
+            fprintf(stderr, "The incremental check decided some requests differently from the full check\n");
+        }
+    }
+
+    bankerFree(b);
+    free(safeSeq);
+    return 0;
+}
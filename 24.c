@@ -0,0 +1,832 @@
+// Run the page replacement algorithms from 10.c (FCFS), 11.c (LRU) and 12.c (Optimal) on traces
+// of any length with any number of frames. The reference string is a binary file of 32-bit page
+// numbers that is mapped into memory instead of read with scanf, so a trace of billions of
+// references costs no more memory than its page cache. A hash table from page to frame replaces
+// the scan through every frame on each reference, and LRU keeps the frames on a recency list, so
+// a hit or a replacement takes the same time with millions of frames as with three. Printing
+// every access is off by default; the output is the number of faults and the hit ratio of each
+// algorithm.
+//
+// Compile: gcc -O2 24.c -o pagesim
+// Usage:   ./pagesim [-a fifo|lru|opt] [-f frames] [-v] [-B] [-M] trace
+//          ./pagesim -g references [-p pages] [-s seed] trace
+//          ./pagesim -c trace < pages.txt
+//            -a  replacement algorithm to run (default: all of them)
+//            -f  number of frames (default 3)
+//            -v  print every access and the frames after every fault, like 10.c to 12.c, and
+//                each algorithm's total instead of the table
+//            -B  accesses per second of one algorithm (-a, default lru) from 1024 frames up to
+//                4M frames, four times as many each step
+//            -M  LRU faults for every frame count from 1 to -f (default: the distinct pages), from
+//                one pass over the trace
+//            -g  write a random trace of this many references instead: mostly references to a
+//                working set that drifts through the pages, with some to any page
+//            -p  distinct pages in a generated trace (default 65536)
+//            -s  seed for the generated trace (default 1)
+//            -c  write the pages read from stdin as a trace; the input is typed as for 10.c to 12.c,
+//                the number of pages and then the page numbers
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define WRITE_CHUNK 65536 // References buffered per write when making a trace
+#define WORKING_SET_PERCENT 90
+#define NOT_LISTED -2
+#define NEVER UINT32_MAX // Next use of a page that is not referenced again
+#define SWEEP_MIN_FRAMES 1024
+#define SWEEP_MAX_FRAMES (4 << 20)
+
+// Open addressing hash table from page number to the frame holding it, with linear probing.
+// frame is -1 in an empty slot; deletion shifts later entries back instead of leaving tombstones.
+struct PageSlot {
+    uint32_t page;
+    int32_t frame;
+};
+
+struct PageMap {
+    struct PageSlot *slots;
+    size_t mask;
+};
+
+// The frames and what each algorithm keeps about them
+struct Sim {
+    size_t frames;   // Number of frames
+    size_t used;     // Frames filled so far; they fill in order before anything is replaced
+    uint32_t *page;  // Page held by each frame
+    struct PageMap map;
+    size_t fifoNext; // FIFO: the frame loaded longest ago
+    int32_t *prev;   // LRU: recency list through the frames, from head (most recently used) to
+    int32_t *next;   // tail (least recently used); prev is NOT_LISTED while a frame is off it
+    int32_t head;
+    int32_t tail;
+    const uint32_t *nextUse; // Optimal: for every reference, the next one to the same page
+    uint32_t *frameNext;     // Optimal: next use of the page in each frame
+    int32_t *heap;           // Optimal: max-heap of frames by frameNext, the victim on top
+    int32_t *heapPos;        // Optimal: where each frame is in the heap, or -1
+    size_t heapSize;
+};
+
+// A replacement algorithm: choose the frame to replace when all are full, and hear about every
+// reference to a frame (a hit, or a page just loaded into it)
+struct Policy {
+    const char *name;
+    size_t (*victim)(struct Sim *s, const uint32_t *trace, size_t n, size_t i);
+    void (*touch)(struct Sim *s, size_t frame, size_t i);
+    bool needsNextUse;
+};
+
+double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// The tables here grow with the frame count and the trace, which is exactly where an allocation
+// fails. There is nothing to fall back to, so say how much memory was asked for and stop.
+void outOfMemory(size_t count, size_t size) {
+    fprintf(stderr, "Out of memory: could not allocate %zu x %zu bytes\n", count, size);
+    exit(1);
+}
+
+void *mustMalloc(size_t count, size_t size) {
+    size_t bytes;
+    void *p = NULL;
+
+    if (!__builtin_mul_overflow(count, size, &bytes)) {
+        p = malloc(bytes);
+    }
+    if (p == NULL) {
+        outOfMemory(count, size);
+    }
+    return p;
+}
+
+void *mustCalloc(size_t count, size_t size) {
+    void *p = calloc(count, size);
+
+    if (p == NULL) {
+        outOfMemory(count, size);
+    }
+    return p;
+}
+
+void *mustRealloc(void *old, size_t count, size_t size) {
+    size_t bytes;
+    void *p = NULL;
+
+    if (!__builtin_mul_overflow(count, size, &bytes)) {
+        p = realloc(old, bytes);
+    }
+    if (p == NULL) {
+        outOfMemory(count, size);
+    }
+    return p;
+}
+
+static inline size_t pageHash(uint32_t page, size_t mask) {
+    return (size_t)((page * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+}
+
+void mapInit(struct PageMap *m, size_t frames) {
+    size_t capacity = 16;
+
+    while (capacity < 2 * frames) {
+        capacity *= 2; // At most half full
+    }
+    m->slots = mustMalloc(capacity, sizeof(struct PageSlot));
+    m->mask = capacity - 1;
+    for (size_t i = 0; i < capacity; i++) {
+        m->slots[i].frame = -1;
+    }
+}
+
+// Frame holding page, or -1
+static inline int32_t mapGet(const struct PageMap *m, uint32_t page) {
+    for (size_t i = pageHash(page, m->mask);; i = (i + 1) & m->mask) {
+        if (m->slots[i].frame < 0 || m->slots[i].page == page) {
+            return m->slots[i].frame;
+        }
+    }
+}
+
+static inline void mapPut(struct PageMap *m, uint32_t page, int32_t frame) {
+    size_t i = pageHash(page, m->mask);
+
+    while (m->slots[i].frame >= 0) {
+        i = (i + 1) & m->mask;
+    }
+    m->slots[i].page = page;
+    m->slots[i].frame = frame;
+}
+
+// Remove page, which must be present, and move back any entry that probed past its slot
+static inline void mapRemove(struct PageMap *m, uint32_t page) {
+    size_t i = pageHash(page, m->mask);
+
+    while (m->slots[i].page != page || m->slots[i].frame < 0) {
+        i = (i + 1) & m->mask;
+    }
+    for (size_t j = (i + 1) & m->mask; m->slots[j].frame >= 0; j = (j + 1) & m->mask) {
+        size_t home = pageHash(m->slots[j].page, m->mask);
+        if (((j - home) & m->mask) >= ((j - i) & m->mask)) { // Home is at or before the hole
+            m->slots[i] = m->slots[j];
+            i = j;
+        }
+    }
+    m->slots[i].frame = -1;
+}
+
+// Hash table from page to a 32-bit value for the whole trace, doubling when it is half full
+struct GrowMap {
+    uint32_t *pages;
+    uint32_t *values; // NEVER in an empty slot
+    size_t mask;
+    size_t count;
+};
+
+void growMapInit(struct GrowMap *m) {
+    m->mask = 1023;
+    m->count = 0;
+    m->pages = mustMalloc(m->mask + 1, sizeof(uint32_t));
+    m->values = mustMalloc(m->mask + 1, sizeof(uint32_t));
+    memset(m->values, 0xff, (m->mask + 1) * sizeof(uint32_t));
+}
+
+void growMapFree(struct GrowMap *m) {
+    free(m->pages);
+    free(m->values);
+}
+
+static inline size_t growMapSlot(const struct GrowMap *m, uint32_t page) {
+    size_t i = pageHash(page, m->mask);
+
+    while (m->values[i] != NEVER && m->pages[i] != page) {
+        i = (i + 1) & m->mask;
+    }
+    return i;
+}
+
+// The value of page, which the caller may overwrite; NEVER if page has not been seen before, in
+// which case the caller must store something else there
+uint32_t *growMapFind(struct GrowMap *m, uint32_t page) {
+    size_t i = growMapSlot(m, page);
+
+    if (m->values[i] != NEVER) {
+        return &m->values[i];
+    }
+    if (++m->count > (m->mask + 1) / 2) {
+        struct GrowMap old = *m;
+        m->mask = 2 * old.mask + 1;
+        m->pages = mustMalloc(m->mask + 1, sizeof(uint32_t));
+        m->values = mustMalloc(m->mask + 1, sizeof(uint32_t));
+        memset(m->values, 0xff, (m->mask + 1) * sizeof(uint32_t));
+        for (size_t k = 0; k <= old.mask; k++) {
+            if (old.values[k] != NEVER) {
+                size_t to = growMapSlot(m, old.pages[k]);
+                m->pages[to] = old.pages[k];
+                m->values[to] = old.values[k];
+            }
+        }
+        growMapFree(&old);
+        i = growMapSlot(m, page);
+    }
+    m->pages[i] = page;
+    return &m->values[i];
+}
+
+// FIFO (10.c): frames are replaced in the order they were filled, so the victim goes round them
+size_t fifoVictim(struct Sim *s, const uint32_t *trace, size_t n, size_t i) {
+    (void)trace;
+    (void)n;
+    (void)i;
+    size_t frame = s->fifoNext;
+    s->fifoNext = (s->fifoNext + 1) % s->frames;
+    return frame;
+}
+
+void fifoTouch(struct Sim *s, size_t frame, size_t i) {
+    (void)s;
+    (void)frame;
+    (void)i;
+}
+
+static inline void lruUnlink(struct Sim *s, int32_t frame) {
+    if (s->prev[frame] >= 0) {
+        s->next[s->prev[frame]] = s->next[frame];
+    } else {
+        s->head = s->next[frame];
+    }
+    if (s->next[frame] >= 0) {
+        s->prev[s->next[frame]] = s->prev[frame];
+    } else {
+        s->tail = s->prev[frame];
+    }
+    s->prev[frame] = NOT_LISTED;
+}
+
+// LRU (11.c): the victim is the tail of the recency list, taken off it until its new page is in
+size_t lruVictim(struct Sim *s, const uint32_t *trace, size_t n, size_t i) {
+    (void)trace;
+    (void)n;
+    (void)i;
+    int32_t frame = s->tail;
+    lruUnlink(s, frame);
+    return frame;
+}
+
+// Every reference moves its frame to the head of the list
+void lruTouch(struct Sim *s, size_t frame, size_t i) {
+    (void)i;
+    if ((int32_t)frame == s->head) {
+        return;
+    }
+    if (s->prev[frame] != NOT_LISTED) {
+        lruUnlink(s, frame);
+    }
+    s->prev[frame] = -1;
+    s->next[frame] = s->head;
+    if (s->head >= 0) {
+        s->prev[s->head] = frame;
+    } else {
+        s->tail = frame;
+    }
+    s->head = frame;
+}
+
+// Next use of every reference in one backward pass, remembering where each page was seen last.
+// The trace must have fewer than NEVER references.
+uint32_t *buildNextUse(const uint32_t *trace, size_t n) {
+    uint32_t *nextUse = malloc(n * sizeof(uint32_t));
+    struct GrowMap seen;
+
+    if (nextUse == NULL) {
+        fprintf(stderr, "Out of memory: opt needs the next use of every reference, %zu x %zu bytes "
+                        "(%.2f GB)\n", n, sizeof(uint32_t), n * sizeof(uint32_t) / 1e9);
+        exit(1);
+    }
+
+    growMapInit(&seen);
+    for (size_t i = n; i-- > 0;) {
+        uint32_t *last = growMapFind(&seen, trace[i]);
+        nextUse[i] = *last;
+        *last = (uint32_t)i;
+    }
+    growMapFree(&seen);
+    return nextUse;
+}
+
+// Whether frame a is replaced before frame b: its page is used later, or neither is used again
+// and a comes first, as in 12.c
+static inline bool replaceBefore(const struct Sim *s, int32_t a, int32_t b) {
+    return s->frameNext[a] > s->frameNext[b] || (s->frameNext[a] == s->frameNext[b] && a < b);
+}
+
+static inline void heapSwap(struct Sim *s, size_t i, size_t j) {
+    int32_t t = s->heap[i];
+    s->heap[i] = s->heap[j];
+    s->heap[j] = t;
+    s->heapPos[s->heap[i]] = i;
+    s->heapPos[s->heap[j]] = j;
+}
+
+// Move the frame at heap position i to where its changed next use belongs
+static void heapFix(struct Sim *s, size_t i) {
+    while (i > 0 && replaceBefore(s, s->heap[i], s->heap[(i - 1) / 2])) {
+        heapSwap(s, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+    for (;;) {
+        size_t first = i;
+        for (size_t child = 2 * i + 1; child <= 2 * i + 2 && child < s->heapSize; child++) {
+            if (replaceBefore(s, s->heap[child], s->heap[first])) {
+                first = child;
+            }
+        }
+        if (first == i) {
+            return;
+        }
+        heapSwap(s, i, first);
+        i = first;
+    }
+}
+
+// Optimal (12.c): the victim is the frame whose page is used again furthest in the future, which
+// is always on top of the heap, so each reference costs O(log frames) instead of a scan forward
+size_t optVictim(struct Sim *s, const uint32_t *trace, size_t n, size_t i) {
+    (void)trace;
+    (void)n;
+    (void)i;
+    return s->heap[0];
+}
+
+// Every reference gives its frame the next use of its page
+void optTouch(struct Sim *s, size_t frame, size_t i) {
+    s->frameNext[frame] = s->nextUse[i];
+    if (s->heapPos[frame] < 0) {
+        s->heap[s->heapSize] = frame;
+        s->heapPos[frame] = s->heapSize++;
+    }
+    heapFix(s, s->heapPos[frame]);
+}
+
+const struct Policy policies[] = {
+    {"fifo", fifoVictim, fifoTouch, false},
+    {"lru", lruVictim, lruTouch, false},
+    {"opt", optVictim, optTouch, true},
+};
+const int policyCount = sizeof(policies) / sizeof(policies[0]);
+
+const struct Policy *findPolicy(const char *name) {
+    for (int p = 0; p < policyCount; p++) {
+        if (strcmp(name, policies[p].name) == 0) {
+            return &policies[p];
+        }
+    }
+    return NULL;
+}
+
+void simInit(struct Sim *s, size_t frames, const uint32_t *nextUse) {
+    memset(s, 0, sizeof(*s));
+    s->frames = frames;
+    s->page = mustMalloc(frames, sizeof(uint32_t));
+    s->prev = mustMalloc(frames, sizeof(int32_t));
+    s->next = mustMalloc(frames, sizeof(int32_t));
+    s->head = s->tail = -1;
+    for (size_t f = 0; f < frames; f++) {
+        s->prev[f] = NOT_LISTED;
+    }
+    s->nextUse = nextUse;
+    s->frameNext = mustMalloc(frames, sizeof(uint32_t));
+    s->heap = mustMalloc(frames, sizeof(int32_t));
+    s->heapPos = mustMalloc(frames, sizeof(int32_t));
+    memset(s->heapPos, 0xff, frames * sizeof(int32_t));
+    mapInit(&s->map, frames);
+}
+
+void simFree(struct Sim *s) {
+    free(s->page);
+    free(s->prev);
+    free(s->next);
+    free(s->frameNext);
+    free(s->heap);
+    free(s->heapPos);
+    free(s->map.slots);
+}
+
+// Function to display the frames
+void displayFrames(const struct Sim *s) {
+    printf("Current frames: ");
+    for (size_t f = 0; f < s->frames; f++) {
+        if (f < s->used) {
+            printf("%u ", s->page[f]);
+        } else {
+            printf(" - ");
+        }
+    }
+    printf("\n");
+}
+
+// Run one algorithm over the whole trace and return the number of page faults. nextUse is only
+// needed by Optimal.
+size_t simulate(const struct Policy *policy, size_t frames, const uint32_t *trace, const uint32_t *nextUse,
+                size_t n, bool verbose) {
+    struct Sim s;
+    size_t faults = 0;
+
+    simInit(&s, frames, nextUse);
+    for (size_t i = 0; i < n; i++) {
+        uint32_t page = trace[i];
+        int32_t frame = mapGet(&s.map, page);
+
+        if (verbose) {
+            printf("Processing page: %u\n", page);
+        }
+        if (frame >= 0) {
+            policy->touch(&s, frame, i);
+            if (verbose) {
+                printf("Page %u already in frames, no page fault.\n", page);
+            }
+            continue;
+        }
+        faults++;
+        if (s.used < s.frames) {
+            frame = s.used++;
+        } else {
+            frame = policy->victim(&s, trace, n, i);
+            mapRemove(&s.map, s.page[frame]);
+        }
+        s.page[frame] = page;
+        mapPut(&s.map, page, frame);
+        policy->touch(&s, frame, i);
+        if (verbose) {
+            displayFrames(&s);
+        }
+    }
+    simFree(&s);
+    return faults;
+}
+
+// Fenwick tree over timestamp slots 1..size, counting the slots marked 1
+static inline void fenwickAdd(uint32_t *tree, size_t size, size_t slot, int delta) {
+    for (size_t i = slot + 1; i <= size; i += i & -i) {
+        tree[i] += delta;
+    }
+}
+
+// Marks in slots 0..slot
+static inline size_t fenwickPrefix(const uint32_t *tree, size_t slot) {
+    size_t sum = 0;
+    for (size_t i = slot + 1; i > 0; i -= i & -i) {
+        sum += tree[i];
+    }
+    return sum;
+}
+
+// Mattson's stack algorithm: LRU with F frames hits a reference exactly when its stack distance,
+// the number of distinct pages used since the last reference to its page (itself included), is at
+// most F. One pass that counts how often each distance occurs therefore gives the faults of every
+// frame count. A Fenwick tree over timestamps has a 1 at the latest reference to each page, so a
+// distance is the number of ones after the page's previous timestamp. Timestamps are renumbered
+// densely whenever they run out, which keeps the tree at most four times the distinct pages.
+// Returns hits[d], the references at distance d, for d up to the number of distinct pages.
+size_t *stackDistances(const uint32_t *trace, size_t n, size_t *distinct) {
+    size_t size = 1024, now = 0, active = 0;
+    uint32_t *tree = mustCalloc(size + 1, sizeof(uint32_t));
+    uint32_t *slotPage = mustMalloc(size, sizeof(uint32_t)); // Page referenced at each timestamp
+    size_t *hits = mustCalloc(size + 1, sizeof(size_t));
+    struct GrowMap last; // Page to the timestamp of its latest reference
+
+    growMapInit(&last);
+    for (size_t i = 0; i < n; i++) {
+        if (now == size) {
+            // Out of timestamps: give the latest reference to each page timestamps 0..active-1 in
+            // the same order, in a tree at least twice that size
+            size_t kept = 0;
+            for (size_t t = 0; t < now; t++) {
+                uint32_t *latest = growMapFind(&last, slotPage[t]);
+                if (*latest == t) {
+                    *latest = (uint32_t)kept;
+                    slotPage[kept++] = slotPage[t];
+                }
+            }
+            if (2 * active > size) {
+                size *= 2;
+                free(tree);
+                tree = mustMalloc(size + 1, sizeof(uint32_t));
+                slotPage = mustRealloc(slotPage, size, sizeof(uint32_t));
+                hits = mustRealloc(hits, size + 1, sizeof(size_t));
+                memset(hits + size / 2 + 1, 0, size / 2 * sizeof(size_t));
+            }
+            memset(tree, 0, (size + 1) * sizeof(uint32_t));
+            for (size_t k = 1; k <= size; k++) { // Linear-time build, ones in the first kept slots
+                tree[k] += k <= kept;
+                if (k + (k & -k) <= size) {
+                    tree[k + (k & -k)] += tree[k];
+                }
+            }
+            now = kept;
+        }
+
+        uint32_t *latest = growMapFind(&last, trace[i]);
+        if (*latest != NEVER) {
+            hits[active - fenwickPrefix(tree, *latest) + 1]++;
+            fenwickAdd(tree, size, *latest, -1);
+        } else {
+            active++; // First reference: a fault at any frame count
+        }
+        *latest = (uint32_t)now;
+        slotPage[now] = trace[i];
+        fenwickAdd(tree, size, now++, 1);
+    }
+    growMapFree(&last);
+    free(tree);
+    free(slotPage);
+    *distinct = active;
+    return hits;
+}
+
+// Map a trace file; returns the number of references, or 0 on error
+size_t mapTrace(const char *path, const uint32_t **trace) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+
+    if (fd < 0) {
+        perror(path);
+        return 0;
+    }
+    if (fstat(fd, &st) < 0) {
+        perror(path);
+        close(fd);
+        return 0;
+    }
+    if (st.st_size == 0 || st.st_size % sizeof(uint32_t) != 0) {
+        fprintf(stderr, "%s: not a trace of 32-bit page numbers\n", path);
+        close(fd);
+        return 0;
+    }
+    void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        return 0;
+    }
+    madvise(p, st.st_size, MADV_SEQUENTIAL);
+    *trace = p;
+    return st.st_size / sizeof(uint32_t);
+}
+
+static inline uint64_t xorshift64(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+// A trace with locality: most references fall in a window of pages/16 pages that moves on by
+// one page every 64 references, and the rest go to any page
+int generateTrace(const char *path, size_t references, uint32_t pages, unsigned seed) {
+    FILE *out = fopen(path, "wb");
+    uint32_t *chunk = mustMalloc(WRITE_CHUNK, sizeof(uint32_t));
+    uint32_t window = pages / 16 > 0 ? pages / 16 : 1;
+    uint64_t rng = seed * 0x9E3779B97F4A7C15ull + 1;
+
+    if (out == NULL) {
+        perror(path);
+        free(chunk);
+        return 1;
+    }
+    for (size_t done = 0; done < references;) {
+        size_t count = references - done < WRITE_CHUNK ? references - done : WRITE_CHUNK;
+        for (size_t k = 0; k < count; k++) {
+            uint64_t r = xorshift64(&rng);
+            uint32_t base = (uint32_t)((done + k) / 64 % pages);
+            if (r % 100 < WORKING_SET_PERCENT) {
+                chunk[k] = (base + (uint32_t)((r >> 8) % window)) % pages;
+            } else {
+                chunk[k] = (uint32_t)((r >> 8) % pages);
+            }
+        }
+        if (fwrite(chunk, sizeof(uint32_t), count, out) != count) {
+            perror(path);
+            fclose(out);
+            free(chunk);
+            return 1;
+        }
+        done += count;
+    }
+    free(chunk);
+    return fclose(out) != 0;
+}
+
+// Input typed the way 10.c to 12.c read it, the number of pages and then the page numbers,
+// written as a trace
+int convertTrace(const char *path) {
+    long long count, page;
+
+    if (scanf("%lld", &count) != 1 || count <= 0) {
+        fprintf(stderr, "Expected the number of pages, then the page numbers, on stdin\n");
+        return 1;
+    }
+    FILE *out = fopen(path, "wb");
+    if (out == NULL) {
+        perror(path);
+        return 1;
+    }
+    for (long long i = 0; i < count; i++) {
+        if (scanf("%lld", &page) != 1) {
+            fprintf(stderr, "Expected %lld page numbers, got %lld\n", count, i);
+            fclose(out);
+            return 1;
+        }
+        if (page < 0 || page > UINT32_MAX) {
+            fprintf(stderr, "Page numbers must be between 0 and %u: %lld\n", UINT32_MAX, page);
+            fclose(out);
+            return 1;
+        }
+        uint32_t p = (uint32_t)page;
+        if (fwrite(&p, sizeof(p), 1, out) != 1) {
+            perror(path);
+            fclose(out);
+            return 1;
+        }
+    }
+    if (fclose(out) != 0) { // A full disk may only show up when the last buffer is written
+        perror(path);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *only = NULL;
+    long frames = 3;
+    bool verbose = false;
+    long long references = 0;
+    long pages = 65536;
+    unsigned seed = 1;
+    bool convert = false;
+    bool sweep = false;
+    bool curve = false;
+    bool framesSet = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "a:f:vBMg:p:s:c")) != -1) {
+        switch (opt) {
+        case 'a':
+            only = optarg;
+            break;
+        case 'f':
+            frames = atol(optarg);
+            framesSet = true;
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        case 'B':
+            sweep = true;
+            break;
+        case 'M':
+            curve = true;
+            break;
+        case 'g':
+            references = atoll(optarg);
+            break;
+        case 'p':
+            pages = atol(optarg);
+            break;
+        case 's':
+            seed = (unsigned)atol(optarg);
+            break;
+        case 'c':
+            convert = true;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-a fifo|lru|opt] [-f frames] [-v] [-B] [-M] trace\n", argv[0]);
+            fprintf(stderr, "       %s -g references [-p pages] [-s seed] trace\n", argv[0]);
+            fprintf(stderr, "       %s -c trace < pages.txt\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc - 1) {
+        fprintf(stderr, "Expected one trace file\n");
+        return 1;
+    }
+    const char *path = argv[optind];
+
+    if (convert) {
+        return convertTrace(path);
+    }
+    if (references > 0) {
+        if (pages <= 0 || pages > UINT32_MAX) {
+            fprintf(stderr, "Pages must be between 1 and %u\n", UINT32_MAX);
+            return 1;
+        }
+        return generateTrace(path, references, (uint32_t)pages, seed);
+    }
+    if (frames <= 0 || frames > INT32_MAX) {
+        fprintf(stderr, "Frames must be between 1 and %d\n", INT32_MAX);
+        return 1;
+    }
+    if (only != NULL && findPolicy(only) == NULL) {
+        fprintf(stderr, "Unknown algorithm: %s\n", only);
+        return 1;
+    }
+    if (curve && only != NULL && strcmp(only, "lru") != 0) {
+        fprintf(stderr, "-M computes the LRU fault curve only, not %s\n", only);
+        return 1;
+    }
+
+    const uint32_t *trace;
+    size_t n = mapTrace(path, &trace);
+    if (n == 0) {
+        return 1;
+    }
+
+    if (curve) {
+        size_t distinct;
+        double start = nowSeconds();
+        size_t *hits = stackDistances(trace, n, &distinct);
+        double elapsed = nowSeconds() - start;
+        size_t last = framesSet ? (size_t)frames : distinct;
+        size_t hitCount = 0;
+
+        printf("lru, %zu references, %zu distinct pages, one pass in %.3f seconds\n\n", n, distinct, elapsed);
+        printf("Frames\t\tFaults\t\tFault ratio\n");
+        for (size_t f = 1; f <= last; f++) {
+            hitCount += f <= distinct ? hits[f] : 0;
+            printf("%-8zu\t%-12zu\t%.6f\n", f, n - hitCount, (double)(n - hitCount) / n);
+        }
+        free(hits);
+        munmap((void *)trace, n * sizeof(uint32_t));
+        return 0;
+    }
+
+    uint32_t *nextUse = NULL;
+    if (n >= NEVER) {
+        for (int p = 0; p < policyCount; p++) {
+            if (policies[p].needsNextUse && (only == NULL || strcmp(only, policies[p].name) == 0)) {
+                fprintf(stderr, "%s needs a trace of fewer than %u references\n", policies[p].name, NEVER);
+                return 1;
+            }
+        }
+    }
+
+    if (sweep) {
+        const struct Policy *policy = findPolicy(only != NULL ? only : "lru");
+        printf("%s, %zu references\n", policy->name, n);
+        if (policy->needsNextUse) {
+            double start = nowSeconds();
+            nextUse = buildNextUse(trace, n);
+            printf("Next-use array built in %.3f seconds\n", nowSeconds() - start);
+        }
+        printf("\n");
+        printf("Frames\t\tFault ratio\tSeconds\t\tAccesses/sec\n");
+        for (size_t f = SWEEP_MIN_FRAMES; f <= SWEEP_MAX_FRAMES; f *= 4) {
+            double start = nowSeconds();
+            size_t faults = simulate(policy, f, trace, nextUse, n, false);
+            double elapsed = nowSeconds() - start;
+            printf("%-8zu\t%.6f\t%.3f\t\t%.0f\n", f, (double)faults / n, elapsed, n / elapsed);
+        }
+        free(nextUse);
+        munmap((void *)trace, n * sizeof(uint32_t));
+        return 0;
+    }
+
+    printf("%zu references, %ld frames\n\n", n, frames);
+    if (!verbose) {
+        printf("Algorithm\tFaults\t\tHits\t\tFault ratio\tHit ratio\tSeconds\n");
+    }
+    for (int p = 0; p < policyCount; p++) {
+        if (only != NULL && strcmp(only, policies[p].name) != 0) {
+            continue;
+        }
+        if (verbose) {
+            printf("%s\n", policies[p].name);
+        }
+        double start = nowSeconds();
+        if (policies[p].needsNextUse && nextUse == NULL) {
+            nextUse = buildNextUse(trace, n); // Counted in the time of the first algorithm to use it
+        }
+        size_t faults = simulate(&policies[p], frames, trace, nextUse, n, verbose);
+        double elapsed = nowSeconds() - start;
+        if (verbose) {
+            // The accesses of every algorithm would split a table, so each just ends with its total
+            printf("Total number of page faults: %zu\n\n", faults);
+            continue;
+        }
+        printf("%-8s\t%-12zu\t%-12zu\t%.6f\t%.6f\t%.3f\n", policies[p].name, faults, n - faults,
+               (double)faults / n, (double)(n - faults) / n, elapsed);
+    }
+    free(nextUse);
+    munmap((void *)trace, n * sizeof(uint32_t));
+    return 0;
+}